@@ -18,12 +18,17 @@
  *
  ***************************************************************************/
 
+#ifdef BISPE_USER
+#include "bispe_user.h"
+#else
 #include <linux/kernel.h>
 #include <linux/vmalloc.h>
 #include <linux/string.h>
 #include <linux/kthread.h>
 #include <linux/random.h>
 #include <linux/uaccess.h>
+#include <linux/ktime.h>
+#endif
 
 #include "bispe_comm.h"
 #include "bispe_defines.h"
@@ -68,6 +73,12 @@ size_t bispe_stack_seg_size = 0;
 size_t bispe_call_seg_size = 0;
 size_t bispe_print_seg_size = 0;
 
+/*
+ * Size in bytes of the code verified by bispe_verify_code, run by the
+ * unchecked engine; 0 if the code is run by the checked engine
+ */
+size_t bispe_code_verified_size = 0;
+
 /* 
  * Holds program arguments:
  * if argc is 0, argv is NULL
@@ -75,6 +86,48 @@ size_t bispe_print_seg_size = 0;
 size_t bispe_argc;
 uint32_t *bispe_argv;
 
+#ifdef STATS
+uint64_t bispe_invoke_stamps[INVOKE_EVENTS];
+#endif
+
+/* Instruction cycle implementation with its register setup and cleanup */
+struct cycle_engine {
+	const char *name;
+	void (*gen_rkeys)(void);
+	void (*cycle_entry)(void);
+	/* for verified code, NULL if the engine has no unchecked variant */
+	void (*cycle_entry_unchecked)(void);
+	void (*clear_regs)(void);
+};
+
+static const struct cycle_engine engine_avx = {
+	.name = "AVX",
+	.gen_rkeys = bispe_gen_rkeys,
+	.cycle_entry = bispe_cycle_entry,
+	.clear_regs = bispe_clear_regs,
+};
+
+static const struct cycle_engine engine_vaes = {
+	.name = "AVX/VAES",
+	.gen_rkeys = bispe_gen_rkeys,
+	.cycle_entry = bispe_cycle_entry_vaes,
+	.clear_regs = bispe_clear_regs,
+};
+
+static const struct cycle_engine engine_avx512 = {
+	.name = "AVX-512",
+	.gen_rkeys = bispe_gen_rkeys_avx512,
+	.cycle_entry = bispe_cycle_entry_avx512,
+	.cycle_entry_unchecked = bispe_cycle_entry_avx512_unchecked,
+	.clear_regs = bispe_clear_regs_avx512,
+};
+
+/* Engine used by start_interpreter, NULL until selected */
+static const struct cycle_engine *engine = NULL;
+
+/* Code is verified at the start of execution, if the engine supports it */
+static bool verification = 1;
+
 /*
  * Returns pointer to "size" bytes memory, aligned to ALIGMENT.
  * Allocates memory, then adjusts the pointer to fit the alignment.
@@ -196,7 +249,7 @@ static struct runtime_ctx *create_runtime_ctx(struct invoke_ctx *invoke_ctx,
 												struct buf_info *arg_buf)
 {
 	/* allocate runtime context */
-	struct runtime_ctx *runtime_ctx = vzalloc(sizeof(runtime_ctx));
+	struct runtime_ctx *runtime_ctx = vzalloc(sizeof(*runtime_ctx));
 	if (runtime_ctx == NULL) {
 		goto error;
 	}
@@ -235,17 +288,17 @@ static struct runtime_ctx *create_runtime_ctx(struct invoke_ctx *invoke_ctx,
 	#endif
 
 	/* allocate segment memory */
-	runtime_ctx->stack_seg_bp = amalloc(bispe_stack_seg_size);
+	runtime_ctx->stack_seg_bp = amalloc(runtime_ctx->stack_seg_size);
 	if (runtime_ctx->stack_seg_bp == NULL) {
 		goto error;
 	}
 
-	runtime_ctx->call_seg_bp = amalloc(bispe_call_seg_size);
+	runtime_ctx->call_seg_bp = amalloc(runtime_ctx->call_seg_size);
 	if (runtime_ctx->call_seg_bp == NULL) {
 		goto error;
 	}
 
-	runtime_ctx->print_seg_bp = amalloc(bispe_print_seg_size);
+	runtime_ctx->print_seg_bp = amalloc(runtime_ctx->print_seg_size);
 	if (runtime_ctx->print_seg_bp == NULL) {
 		goto error;
 	}
@@ -277,12 +330,19 @@ error:
 	return NULL;
 }
 
+/*
+ * The AVX-512 engine reads code in units of 64 bytes (see CODE UNITS in
+ * asm_state_macros.S), the last one may reach up to 64 bytes behind the code
+ */
+#define CODE_PADDING 64
+
 /*
  * Allocates a kernel space buffer and copies a buffer from user space to it.
+ * The buffer is followed by "pad" zeroed bytes.
  */ 
-static char *get_buf_from_user(const void __user *src, size_t size)
+static char *get_buf_from_user(const void __user *src, size_t size, size_t pad)
 {
-	char *ptr = (char *) amalloc(size);
+	char *ptr = (char *) amalloc(size + pad);
 	if (ptr == NULL) {
 		return NULL;
 	}
@@ -290,6 +350,7 @@ static char *get_buf_from_user(const void __user *src, size_t size)
 	if (copy_from_user(ptr, src, size) != 0) {
 		return NULL;
 	}
+	memset(ptr + size, 0, pad);
 
 	return ptr;
 }
@@ -305,24 +366,27 @@ struct runtime_ctx *init_interpreter(struct invoke_ctx *invoke_ctx)
 	struct buf_info arg_buf = { .size = invoke_ctx->arg_buf.size };
 
 	/* get buffers from user space */
-	code_buf.ptr = get_buf_from_user(invoke_ctx->code_buf.ptr, invoke_ctx->code_buf.size);
+	code_buf.ptr = get_buf_from_user(invoke_ctx->code_buf.ptr, invoke_ctx->code_buf.size,
+		CODE_PADDING);
 	if(code_buf.ptr == NULL) {
 		printk(KERN_ERR "bispe_invoke: failed to initialize code buffer.\n");
 		goto error;
 	}
 
 	if(invoke_ctx->arg_buf.size > 0) {
-		arg_buf.ptr = get_buf_from_user(invoke_ctx->arg_buf.ptr, invoke_ctx->arg_buf.size);
+		arg_buf.ptr = get_buf_from_user(invoke_ctx->arg_buf.ptr, invoke_ctx->arg_buf.size, 0);
 		if(arg_buf.ptr == NULL) {
 			printk(KERN_ERR "bispe_invoke: failed to initialize argument buffer.\n");
 			goto error;
 		}
 	}
+	bispe_stamp(INVOKE_COPIED_IN);
 
 	runtime_ctx = create_runtime_ctx(invoke_ctx, &code_buf, &arg_buf);
 	if(runtime_ctx == NULL) {
 		printk(KERN_ERR "bispe_invoke: failed to initialize runtime environment.\n");
 	}
+	bispe_stamp(INVOKE_ALLOCATED);
 
 	return runtime_ctx;
 
@@ -343,24 +407,27 @@ struct runtime_ctx *init_interpreter_intern(struct invoke_ctx *invoke_ctx)
 	struct buf_info code_buf = { .size = invoke_ctx->code_buf.size };
 	struct buf_info arg_buf = { .size = invoke_ctx->arg_buf.size };
 
-	code_buf.ptr = amalloc(invoke_ctx->code_buf.size);
+	code_buf.ptr = amalloc(invoke_ctx->code_buf.size + CODE_PADDING);
 	if (code_buf.ptr == NULL) {
 		goto error;
 	}
 	memcpy(code_buf.ptr, invoke_ctx->code_buf.ptr, code_buf.size);
+	memset((char *) code_buf.ptr + code_buf.size, 0, CODE_PADDING);
 
 	if (arg_buf.size > 0) {
 		arg_buf.ptr = amalloc(invoke_ctx->arg_buf.size);
-		if (code_buf.ptr == NULL) {
+		if (arg_buf.ptr == NULL) {
 			goto error;
 		}
 		memcpy(arg_buf.ptr, invoke_ctx->arg_buf.ptr, arg_buf.size);
 	}
+	bispe_stamp(INVOKE_COPIED_IN);
 
 	runtime_ctx = create_runtime_ctx(invoke_ctx, &code_buf, &arg_buf);
 	if (runtime_ctx == NULL) {
 		printk(KERN_ERR "bispe_invoke: failed to initialize runtime environment.\n");
 	}
+	bispe_stamp(INVOKE_ALLOCATED);
 
 	return runtime_ctx;
 error:
@@ -395,6 +462,70 @@ static inline void cycle_epilog(unsigned long *irq_flags)
 	preempt_enable();
 }
 
+/*
+ * Selects the instruction cycle for the CPU features as returned by
+ * bispe_check_features and returns its name. The AVX-512 engine is used
+ * if available, then the AVX engine decrypting pairs of blocks with VAES,
+ * the AVX engine is the fallback.
+ * If no engine was selected, start_interpreter checks the features itself.
+ */
+const char *bispe_select_engine(int features)
+{
+	switch (features) {
+	case BISPE_FEATURES_AVX512:
+		engine = &engine_avx512;
+		break;
+	case BISPE_FEATURES_VAES:
+		engine = &engine_vaes;
+		break;
+	default:
+		engine = &engine_avx;
+	}
+	return engine->name;
+}
+
+/*
+ * Enables or disables the verification of code, which lets the engine run
+ * verified code without the checks the verification makes redundant
+ */
+void bispe_set_verification(bool enable)
+{
+	verification = enable;
+}
+
+/*
+ * Verifies the code with bispe_verify_code in an atomic section of its own,
+ * sets bispe_code_verified_size. The code stays unverified if there is no
+ * memory for the bitmap.
+ */
+static void verify_code(void)
+{
+	unsigned long irq_flags;
+	size_t words = bispe_code_seg_size / 4;
+	uint8_t *bitmap;
+
+	bispe_code_verified_size = 0;
+
+	bitmap = vzalloc((words + 7) / 8);
+	if (bitmap == NULL) {
+		return;
+	}
+
+	cycle_prolog(&irq_flags);
+
+	#ifdef ENCRYPTION
+	engine->gen_rkeys();
+	#endif
+
+	bispe_code_verified_size = bispe_verify_code(bitmap);
+
+	/* the last decrypted line is in the registers */
+	engine->clear_regs();
+	cycle_epilog(&irq_flags);
+
+	vfree(bitmap);
+}
+
 int start_interpreter(struct runtime_ctx *runtime_ctx, int threaded)
 {
 	volatile bool halt = 0;
@@ -432,9 +563,20 @@ int start_interpreter(struct runtime_ctx *runtime_ctx, int threaded)
 
 	bispe_reset_flags();
 
+	if (engine == NULL) {
+		bispe_select_engine(bispe_check_features());
+	}
+
+	bispe_code_verified_size = 0;
+	if (verification && engine->cycle_entry_unchecked != NULL) {
+		verify_code();
+	}
+
+	bispe_stamp(INVOKE_EXEC_BEGIN);
+
 	/*
-	 * Each loop performs one instruction cycle,
-	 * with at most "instr_per_cycle" instructions 
+	 * Each loop performs one instruction cycle, which ends at the first
+	 * jump, call or return after "instr_per_cycle" code words
 	 */
 	while (!threaded || !kthread_should_stop()) {
 		/* 
@@ -449,11 +591,18 @@ int start_interpreter(struct runtime_ctx *runtime_ctx, int threaded)
 
 		#ifdef ENCRYPTION
 		/* generate round keys */
-		bispe_gen_rkeys();
+		engine->gen_rkeys();
 		#endif
 
-		/* transfers control to instruction cycle */
-		bispe_cycle_entry();
+		/*
+		 * transfers control to instruction cycle, the unchecked engine
+		 * resets bispe_code_verified_size if it leaves the verified code
+		 */
+		if (bispe_code_verified_size) {
+			engine->cycle_entry_unchecked();
+		} else {
+			engine->cycle_entry();
+		}
 	
 		/* if halt flag is set, program execution is finished */
 		if (bispe_chk_halt()) {
@@ -464,7 +613,7 @@ int start_interpreter(struct runtime_ctx *runtime_ctx, int threaded)
 		}
 
 		/* clear all registers before anyone else has access again */
-		bispe_clear_regs();
+		engine->clear_regs();
 
 		#ifdef DEBUG
 		printk("---end cycle---\n");
@@ -481,6 +630,8 @@ int start_interpreter(struct runtime_ctx *runtime_ctx, int threaded)
 		}
 	}
 
+	bispe_stamp(INVOKE_EXEC_END);
+
 	/* thread was told by signal to stop */
 	if (threaded && kthread_should_stop()) {
 		printk(KERN_ERR "bispe_interpreter: execution interrupted by fatal signal\n");
@@ -26,6 +26,7 @@
 #include <linux/vmalloc.h>
 #include <linux/kthread.h>
 #include <linux/semaphore.h>
+#include <linux/ktime.h>
 
 #include "bispe_comm.h"
 #include "bispe_interpreter.h"
@@ -79,6 +80,8 @@ static int thread_main(void *data)
 
 static int start_interpreter_thread(struct runtime_ctx *runtime_ctx)
 {
+	int res;
+
 	/* create and run interpreter thread */
 	interpreter_thread = kthread_run(thread_main, runtime_ctx, "bispe_interpreter");
 	if (interpreter_thread == ERR_PTR(-ENOMEM)) {
@@ -88,6 +91,7 @@ static int start_interpreter_thread(struct runtime_ctx *runtime_ctx)
 
 	/* wait until interpreter has finished, but catch fatal signals */
 	down_killable(&interpreter_finish_lock);
+	bispe_stamp(INVOKE_WOKEN);
 
 	/* issue interpreter to stop, returns:
 	 *	-2: if interpreter error'd during init
@@ -95,7 +99,10 @@ static int start_interpreter_thread(struct runtime_ctx *runtime_ctx)
 	 *   0: if interpreter executed normally
 	 *  >0: if a run time error occurred
 	 */
-	return kthread_stop(interpreter_thread);
+	res = kthread_stop(interpreter_thread);
+	bispe_stamp(INVOKE_STOPPED);
+
+	return res;
 }
 
 /***************************************************************************
@@ -144,6 +151,11 @@ static ssize_t invoke_interpreter(struct kobject *kobj, struct kobj_attribute *a
 		return 0;
 	}
 
+#ifdef STATS
+	memset(bispe_invoke_stamps, 0, sizeof(bispe_invoke_stamps));
+#endif
+	bispe_stamp(INVOKE_ENTER);
+
 	runtime_ctx = init_interpreter(invoke_ctx);
 	if(runtime_ctx == NULL) {
 		goto error;
@@ -167,12 +179,15 @@ static ssize_t invoke_interpreter(struct kobject *kobj, struct kobj_attribute *a
 
 	/* pass interpreter result to user space */
 	put_user(interpreter_result, invoke_ctx->result);
+	bispe_stamp(INVOKE_COPIED_OUT);
 
 cleanup:
 	/* perform memory cleanup */
 	cleanup_runtime_ctx(runtime_ctx);
 
 error:
+	bispe_stamp(INVOKE_DONE);
+
 	/* give interpreter free for other processes */
 	mutex_unlock(&interpreter_lock);
 
@@ -247,6 +262,29 @@ static ssize_t encrypt_code(struct kobject *kobj, struct kobj_attribute *attr,
 	return buf_info->size;
 }
 
+#ifdef STATS
+/*
+ * Shows the duration of each phase of the last invoke in ns,
+ * see enum invoke_event in bispe_comm.h
+ */
+static ssize_t show_stats(struct kobject *kobj, struct kobj_attribute *attr,
+			 char *buf)
+{
+	ssize_t len = 0;
+	int i;
+
+	for (i = 1; i < INVOKE_EVENTS; i++) {
+		len += sprintf(buf + len, "%llu%c",
+			(unsigned long long) (bispe_invoke_stamps[i] - bispe_invoke_stamps[i-1]),
+			(i < INVOKE_EVENTS - 1) ? ' ' : '\n');
+	}
+	return len;
+}
+
+static struct kobj_attribute stats_attribute =
+	__ATTR(stats, 0444, show_stats, NULL);
+#endif
+
 static struct kobj_attribute invoke_attribute =
 	__ATTR(invoke, 0664, show_dummy, invoke_interpreter);
 
@@ -260,6 +298,9 @@ static struct attribute *attrs[] = {
 	&invoke_attribute.attr,
 	&crypto_attribute.attr,
 	&password_attribute.attr,
+#ifdef STATS
+	&stats_attribute.attr,
+#endif
 	NULL
 };
 
@@ -345,14 +386,17 @@ static const uint32_t debug_code[] = {
 /* Initialize module */
 static int __init bispe_init(void)
 {
-	int ret;
+	int ret, features;
 	printk(KERN_INFO "bispe: initializing kernel module.\n");
 
-	if (!bispe_check_features()) {
+	features = bispe_check_features();
+	if (features == BISPE_FEATURES_NONE) {
 		printk(KERN_ERR "bispe: CPU does not support AVX and/or AESNI instructions\n");
 		printk(KERN_ERR "bispe: module load failed\n");
 		return 1;
 	}
+	printk(KERN_INFO "bispe: using %s instruction cycle\n",
+		bispe_select_engine(features));
 
 	/* initialize semaphores */
 	mutex_init(&interpreter_lock);
@@ -21,9 +21,13 @@
  */
 
 
+#ifdef BISPE_USER
+#include "bispe_user.h"
+#else
 #include <linux/kernel.h>
 #include <linux/types.h>
 #include <linux/vmalloc.h>
+#endif
 
 /* 
  * SHA256 hash function from TRESOR 
@@ -144,6 +148,6 @@ void bispe_sha256(const char *message, int msglen, unsigned char *digest)
 	a = 0; b = 0; c = 0; d = 0;
 	e = 0; f = 0; g = 0; h = 0;
 	memset(chunk, 0, 64);
-	memset(w, 0, 64);
+	memset(w, 0, sizeof(w));
 	wbinvd();
 }
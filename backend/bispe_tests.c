@@ -134,7 +134,29 @@ static struct test tests[] = {
 			INSTR_DIV,
 			0x1
 		}
-	},	
+	},
+
+	{
+		"check invalid opcode",
+		{ 1, ERR_INV_OPCODE },
+		1, 1, 3,
+		(const uint32_t [])
+		{
+			(0x1 << 8) | INSTR_PUSH, 0x1,
+			0x1
+		}
+	},
+
+	{
+		"check short call underflow",
+		{ 1, ERR_CALL_UNDERFLOW },
+		1, 1, 2,
+		(const uint32_t [])
+		{
+			(0x1 << 8) | INSTR_SHORT | INSTR_EPILOG,
+			0x1
+		}
+	},
 };
 
 static int run_test(struct test *test) {
@@ -0,0 +1,102 @@
+/***************************************************************************
+ * bispe_user.c
+ * Key and code encryption facilities of the user space library
+ *
+ * Copyright (C) 2014-2016	Max Seitzer <maximilian.seitzer@fau.de>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place - Suite 330, Boston, MA 02111-1307 USA.
+ *
+ ***************************************************************************/
+
+#include "bispe_user.h"
+#include "bispe_crypto.h"
+
+#ifdef ENCRYPTION
+const bool bispe_user_encryption = 1;
+#else
+const bool bispe_user_encryption = 0;
+#endif
+
+/*
+ * Set the test key using the same key derivation as password_store
+ * in bispe_key.c, so that programs encrypted by the kernel module
+ * with the same password can be run by the library and vice versa.
+ */
+void bispe_user_set_password(const char *password)
+{
+	unsigned char key[32], key_hash[32];
+	unsigned int i;
+
+	bispe_sha256(password, strnlen(password, 53), key);
+	for (i = 0; i < BISPE_KDF_ITER; i++) {
+		bispe_sha256(key, 32, key_hash);
+		bispe_sha256(key_hash, 32, key);
+	}
+
+	bispe_set_key(key);
+
+	memset(key, 0, 32);
+	memset(key_hash, 0, 32);
+}
+
+/*
+ * Encrypt code in cbc mode like encrypt_code in bispe_main.c does,
+ * the first 128 bit are used as init vector.
+ * Between generating the round keys and the last encryption, no library
+ * functions may be called, as they might use the AVX registers.
+ */
+int bispe_user_encrypt_code(u8 *code, size_t size)
+{
+	size_t i;
+
+	if (size % 16 != 0) {
+		printk(KERN_ERR "bispe_encrypt: code must be multiple of 128 bit\n");
+		return -1;
+	}
+
+	bispe_gen_rkeys();
+
+	/* encrypting in place is fine, the block is read before writing */
+	for (i = 16; i < size; i = i + 16) {
+		bispe_encblk_mem_cbc(&code[i], &code[i], &code[i-16]);
+	}
+
+	bispe_clear_avx_regs();
+
+	return 0;
+}
+
+/*
+ * Decrypt a segment of the interpreter to out, e.g. to inspect the stack after
+ * execution. The segment has to be preceded by its init vector, as it is the
+ * case for all segments of a runtime context.
+ * Without encryption, the segment is just copied.
+ */
+void bispe_user_decrypt_seg(u8 *out, const u8 *seg, size_t size)
+{
+	size_t i;
+
+	if (!bispe_user_encryption) {
+		memcpy(out, seg, size);
+		return;
+	}
+
+	bispe_gen_rkeys();
+
+	for (i = 0; i + 16 <= size; i = i + 16) {
+		bispe_decblk_mem_cbc(&out[i], &seg[i], &seg[i] - 16);
+	}
+
+	bispe_clear_avx_regs();
+}
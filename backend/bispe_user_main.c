@@ -0,0 +1,298 @@
+/***************************************************************************
+ * bispe_user_main.c
+ * Runs bispe executables on the user space build of the interpreter
+ *
+ * Copyright (C) 2014-2016	Max Seitzer <maximilian.seitzer@fau.de>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place - Suite 330, Boston, MA 02111-1307 USA.
+ *
+ ***************************************************************************/
+
+/*
+ * The user space build executes the same instruction cycle as the kernel
+ * module, but without the protection of the atomic section and with the key
+ * in memory instead of the debug registers. It is meant for testing,
+ * profiling with perf and benchmarking only, never for real secrets!
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bispe_user.h"
+#include "bispe_comm.h"
+#include "bispe_defines.h"
+#include "bispe_interpreter.h"
+
+#define DEFAULT_TEST_PASSWORD "bispe-test"
+
+/* string representations corresponding to error codes returned by interpreter */
+static const char *error_code_strings[] = {
+	NULL,
+	"illegal opcode",
+	"invalid jump target",
+	"stack overflow",
+	"stack underflow",
+	"call stack overflow",
+	"call stack underflow",
+	"division by zero",
+	"argument out of range",
+};
+
+/* struct specifying the command line options for getopt */
+static struct option cmd_options[] = {
+	{"stack-size", required_argument, NULL, 0x1},
+	{"call-size", required_argument, NULL, 0x2},
+	{"print-size", required_argument, NULL, 0x3},
+	{"instr-per-cycle", required_argument, NULL, 0x4},
+	{"repeat", required_argument, NULL, 0x5},
+	{NULL, 0, NULL, 0}
+};
+
+static void print_usage(void) {
+	char *args[] = {
+		"[-p <password>]",
+		"[-u]",
+		"[-o <outfile>]",
+		"[--stack-size=<size>]",
+		"[--call-size=<size>]",
+		"[--print-size=<size>]",
+		"[--instr-per-cycle=<instr_per_cycle>]",
+		"[--repeat=<count>]",
+		"<executable>"
+	};
+	printf("usage: ./bispe_user ");
+	for(int i = 0; i < ARRAY_SIZE(args); i++) {
+		printf("%s ", args[i]);
+	}
+	printf("\n");
+}
+
+/* parses a non-negative decimal option value or exits */
+static size_t parse_size(const char *name, const char *arg) {
+	char *endptr = NULL;
+	size_t value = strtoul(arg, &endptr, 10);
+	if(*arg == '\0' || *endptr != '\0') {
+		printf("%s contains invalid character(s)\n", name);
+		exit(EXIT_FAILURE);
+	}
+	return value;
+}
+
+/* reads whole file into newly allocated buffer */
+static char *read_file(const char *path, size_t *size) {
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL) {
+		fprintf(stderr, "error: could not open executable '%s'\n", path);
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	long len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	/* leave space in front for an init vector */
+	char *buf = (len >= 0) ? malloc(len + 16) : NULL;
+	if(buf == NULL || fread(buf + 16, 1, len, fp) != len) {
+		fprintf(stderr, "error: failed reading from '%s'\n", path);
+		free(buf);
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+
+	*size = len;
+	return buf;
+}
+
+static int write_file(const char *path, const char *buf, size_t size) {
+	FILE *fp = fopen(path, "w");
+	if(fp == NULL) {
+		fprintf(stderr, "error: could not open '%s' (%d %s)\n", path,
+			errno, strerror(errno));
+		return -1;
+	}
+
+	int res = (fwrite(buf, 1, size, fp) == size) ? 0 : -1;
+	fclose(fp);
+	return res;
+}
+
+int main(int argc, char *argv[]) {
+	const char *password = DEFAULT_TEST_PASSWORD;
+	const char *outfile = NULL;
+	int unencrypted = 0;
+
+	/* interpreter settings, zero denotes to use the default value */
+	size_t stack_size = 0;
+	size_t call_size = 0;
+	size_t print_size = 40;
+	size_t instr_per_cycle = 0;
+	size_t repeat = 1;
+
+	/* parse command line arguments */
+	int opt;
+	while((opt = getopt_long(argc, argv, "+p:uo:i:", cmd_options, NULL)) != -1) {
+		switch (opt) {
+			case 'p':
+				password = optarg;
+				break;
+			case 'u':
+				unencrypted = 1;
+				break;
+			case 'o':
+				outfile = optarg;
+				break;
+			case 0x1:
+				stack_size = parse_size("stack-size", optarg);
+				break;
+			case 0x2:
+				call_size = parse_size("call-size", optarg);
+				break;
+			case 0x3:
+				print_size = parse_size("print-size", optarg);
+				break;
+			case 'i':
+			case 0x4:
+				instr_per_cycle = parse_size("instr-per-cycle", optarg);
+				break;
+			case 0x5:
+				repeat = parse_size("repeat", optarg);
+				break;
+			default:
+				print_usage();
+				exit(EXIT_FAILURE);
+		}
+	}
+	if(optind >= argc) {
+		print_usage();
+		exit(EXIT_FAILURE);
+	}
+
+	/* build command-line argument array for interpreter, see frontend */
+	int interpr_argc = argc - optind - 1;
+	uint32_t interpr_argv[interpr_argc + 1];
+
+	for(int i = 0; i < interpr_argc; i++) {
+		char *endptr = NULL;
+		const char *arg = argv[optind+1+i];
+
+		errno = 0;
+		long int number = strtol(arg, &endptr, 0);
+
+		if(errno == ERANGE || number > UINT32_MAX || number < INT32_MIN) {
+			fprintf(stderr, "Overflow in interpreter argument '%s'. "
+				"Arguments must 32 bit integers.\n", arg);
+			exit(EXIT_FAILURE);
+		} else if(*endptr != '\0') {
+			fprintf(stderr, "Can not parse interpreter argument '%s': "
+				"Invalid characters.\n", arg);
+			exit(EXIT_FAILURE);
+		}
+		interpr_argv[i] = (uint32_t) number;
+	}
+
+	size_t code_size;
+	char *file_buf = read_file(argv[optind], &code_size);
+	if(file_buf == NULL) {
+		exit(EXIT_FAILURE);
+	}
+	char *code_buf = file_buf + 16;
+
+	if(code_size == 0 || code_size % 16 != 0) {
+		fprintf(stderr, "error: code must be multiple of 128 bit\n");
+		free(file_buf);
+		exit(EXIT_FAILURE);
+	}
+
+	if(bispe_user_encryption) {
+		bispe_user_set_password(password);
+
+		/*
+		 * Unencrypted code (compiled with -u) is encrypted like the kernel
+		 * module's crypto interface does it, after prepending an init vector.
+		 */
+		if(unencrypted) {
+			get_random_bytes(file_buf, 16);
+			code_buf = file_buf;
+			code_size += 16;
+
+			if(bispe_user_encrypt_code((u8 *) code_buf, code_size) != 0) {
+				free(file_buf);
+				exit(EXIT_FAILURE);
+			}
+		}
+	} else if(!unencrypted) {
+		fprintf(stderr, "error: library built without encryption, "
+			"use -u with unencrypted code\n");
+		free(file_buf);
+		exit(EXIT_FAILURE);
+	}
+
+	/* only write the encrypted executable, like the compiler does */
+	if(outfile != NULL) {
+		int res = write_file(outfile, code_buf, code_size);
+		free(file_buf);
+		exit(res == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	size_t print_buf_size = print_size * sizeof(uint32_t);
+	int interpr_result = -1;
+
+	struct invoke_ctx invoke_ctx = {
+		.stack_size = stack_size,
+		.call_size = call_size,
+		.ipc = instr_per_cycle,
+		.code_buf = { (void *) code_buf, code_size },
+		.arg_buf = { (void *) interpr_argv, interpr_argc * sizeof(uint32_t) },
+		.result = &interpr_result,
+		.out_buf = { NULL, print_buf_size }
+	};
+
+	/* the output of the last run is reported */
+	for(size_t run = 0; run < repeat; run++) {
+		struct runtime_ctx *runtime_ctx = init_interpreter_intern(&invoke_ctx);
+		if(runtime_ctx == NULL) {
+			free(file_buf);
+			exit(EXIT_FAILURE);
+		}
+
+		interpr_result = start_interpreter(runtime_ctx, 0);
+
+		if(run == repeat - 1) {
+			if(interpr_result > 0) {
+				if(interpr_result < ARRAY_SIZE(error_code_strings)) {
+					printf("interpreter runtime error %d: %s\n",
+						interpr_result, error_code_strings[interpr_result]);
+				} else {
+					printf("interpreter runtime error %d: unknown error code.\n",
+						interpr_result);
+				}
+			}
+
+			uint32_t *print_seg = bispe_get_print_seg_bp();
+			for(size_t i = 0; i < bispe_get_print_count(); i++) {
+				printf("%d\n", (int32_t) print_seg[i]);
+			}
+		}
+
+		cleanup_runtime_ctx(runtime_ctx);
+	}
+
+	free(file_buf);
+	return (interpr_result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -21,20 +21,35 @@
 #ifndef _BISPE_CRYPTO_H
 #define _BISPE_CRYPTO_H
 
+#ifdef BISPE_USER
+#include "bispe_user.h"
+#else
 #include <linux/kernel.h>
 #include <linux/types.h>
+#endif
 
 #define BISPE_KDF_ITER 2000
 
+/* return values of bispe_check_features */
+#define BISPE_FEATURES_NONE 0	/* AVX or AESNI missing */
+#define BISPE_FEATURES_AVX 1	/* AVX and AESNI */
+#define BISPE_FEATURES_VAES 2	/* AVX2 and VAES, see bispe_cycle_vaes.S */
+#define BISPE_FEATURES_AVX512 3	/* AVX-512 engine usable, see bispe_cycle_avx512.S */
+
 void bispe_sha256(const char *message, int msglen, unsigned char *digest);
 
 /* Assembly functions defined in bispe_crypto_asm.S */
 asmlinkage void bispe_gen_rkeys(void);
+asmlinkage void bispe_gen_rkeys_avx512(void);
 asmlinkage void bispe_clear_avx_regs(void);
 asmlinkage void bispe_clear_regs(void);
+asmlinkage void bispe_clear_regs_avx512(void);
 
 asmlinkage void bispe_encblk(void);
 asmlinkage void bispe_decblk(void);
+asmlinkage void bispe_decblk_avx512(void);
+asmlinkage void bispe_decblk_pair(void);
+asmlinkage void bispe_decblk_pair_avx512(void);
 
 asmlinkage void bispe_encblk_mem(u8 *out, const u8 *in);
 asmlinkage void bispe_decblk_mem(u8 *out, const u8 *in);
@@ -45,7 +60,7 @@ asmlinkage void bispe_decblk_mem_cbc(u8 *out, const u8 *in, const u8 *previous);
 asmlinkage void bispe_set_key(const u8 *in);
 asmlinkage void bispe_get_key(u8 *out);
 
-asmlinkage bool bispe_check_features(void);
+asmlinkage int bispe_check_features(void);
 
 asmlinkage void bispe_dump_regs(u8 *out);
 
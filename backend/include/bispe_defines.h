@@ -76,4 +76,15 @@
 #define INSTR_PROLOG 0x14
 #define INSTR_EPILOG 0x15
 
+#define INSTR_ARGLOAD 0x16
+
+/*
+ * Short form of an instruction with immediate data: the immediate is kept
+ * in the upper 24 bit of the opcode word instead of the next word, the
+ * lower 8 bit are the opcode or'ed with INSTR_SHORT. The constant of push
+ * is sign extended, all other immediates are unsigned.
+ * In the long form, the upper 24 bit of the opcode word must be 0.
+ */
+#define INSTR_SHORT 0x80
+
 #endif /* _BISPE_DEFINES_H */
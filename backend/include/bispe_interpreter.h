@@ -26,6 +26,8 @@ extern struct runtime_ctx runtime_ctx;
 uint32_t *bispe_get_print_seg_bp(void);
 size_t bispe_get_print_count(void);
 
+const char *bispe_select_engine(int features);
+void bispe_set_verification(bool enable);
 int start_interpreter(struct runtime_ctx *runtime_ctx, int threaded);
 
 struct runtime_ctx *init_interpreter(struct invoke_ctx *invoke_ctx);
@@ -33,6 +35,15 @@ struct runtime_ctx *init_interpreter_intern(struct invoke_ctx *invoke_ctx);
 
 void cleanup_runtime_ctx(struct runtime_ctx *runtime_ctx);
 
+#ifdef STATS
+/* time stamps of the last invoke in ns, indexed by enum invoke_event */
+extern uint64_t bispe_invoke_stamps[INVOKE_EVENTS];
+
+#define bispe_stamp(event)	(bispe_invoke_stamps[event] = ktime_get_ns())
+#else
+#define bispe_stamp(event)	do { } while (0)
+#endif
+
 #ifdef TESTS
 void run_interpreter_tests(void);
 #endif
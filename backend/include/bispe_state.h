@@ -21,8 +21,12 @@
 #ifndef _BISPE_STATE_H
 #define _BISPE_STATE_H
 
+#ifdef BISPE_USER
+#include "bispe_user.h"
+#else
 #include <linux/kernel.h>
 #include <linux/types.h>
+#endif
 
 extern uint32_t *bispe_code_seg_bp;
 extern uint32_t *bispe_stack_seg_bp;
@@ -34,6 +38,8 @@ extern size_t bispe_stack_seg_size;
 extern size_t bispe_call_seg_size;
 extern size_t bispe_print_seg_size;
 
+extern size_t bispe_code_verified_size;
+
 extern size_t bispe_argc;
 extern uint32_t *bispe_argv;
 
@@ -45,12 +51,27 @@ void bispe_set_call_ptr(uint32_t *ptr);
 void bispe_set_print_ptr(uint32_t *ptr);
 
 uint32_t *bispe_get_print_ptr(void);
+uint32_t *bispe_get_instr_ptr(void);
+uint32_t *bispe_get_stack_ptr(void);
+uint32_t *bispe_get_call_ptr(void);
 
 bool bispe_chk_halt(void);
 bool bispe_chk_error(void);
 uint8_t bispe_get_error(void);
 
+#ifdef STATS
+/* counted by the instruction cycle, never reset by the interpreter */
+extern uint64_t bispe_stat_instr;
+extern uint64_t bispe_stat_enc;
+extern uint64_t bispe_stat_dec;
+#endif
+
 void bispe_reset_flags(void);
 void bispe_cycle_entry(void);
+void bispe_cycle_entry_vaes(void);
+void bispe_cycle_entry_avx512(void);
+void bispe_cycle_entry_avx512_unchecked(void);
+
+size_t bispe_verify_code(uint8_t *bitmap);
 
 #endif /* _BISPE_STATE_H */
@@ -0,0 +1,127 @@
+/***************************************************************************
+ * bispe_user.h
+ *
+ * Copyright (C) 2014-2016	Max Seitzer <maximilian.seitzer@fau.de>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place - Suite 330, Boston, MA 02111-1307 USA.
+ *
+ ***************************************************************************/
+
+#ifndef _BISPE_USER_H
+#define _BISPE_USER_H
+
+/*
+ * This header is only used if the interpreter is built as user space library
+ * (BISPE_USER defined, see 'make user' in the backend Makefile).
+ * It maps the few kernel facilities the interpreter core relies on to their
+ * user space counterparts, so that the very same C and assembly sources
+ * as in the kernel module are executed.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <time.h>
+
+typedef uint8_t u8;
+
+#define asmlinkage
+#define __user
+
+#define KERN_ERR	""
+#define KERN_INFO	""
+#define printk(...)	fprintf(stderr, __VA_ARGS__)
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+/* interrupts and scheduling can not be controlled from user space */
+#define preempt_disable()			do { } while (0)
+#define preempt_enable()			do { } while (0)
+#define local_irq_save(flags)		do { (void) (flags); } while (0)
+#define local_irq_restore(flags)	do { (void) (flags); } while (0)
+#define touch_softlockup_watchdog()	do { } while (0)
+#define wbinvd()					do { } while (0)
+
+/* the interpreter never runs in a kernel thread in user space */
+#define kthread_should_stop()		0
+
+/*
+ * Segments are mapped instead of taken from the heap: like vmalloc'ed
+ * memory, mappings lie far away from address zero, which the bound checks
+ * of the interpreter rely on. The mapping size is kept in front of the
+ * returned pointer, which keeps the 16 byte alignment intact.
+ */
+static inline void *vmalloc(size_t size)
+{
+	size_t *mem = mmap(NULL, size + 16, PROT_READ | PROT_WRITE,
+						MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		return NULL;
+	}
+
+	mem[0] = size + 16;
+	return (char *) mem + 16;
+}
+
+/* mapped memory is always zeroed */
+static inline void *vzalloc(size_t size)
+{
+	return vmalloc(size);
+}
+
+static inline void vfree(const void *ptr)
+{
+	if (ptr != NULL) {
+		size_t *mem = (size_t *) ((char *) ptr - 16);
+		munmap(mem, mem[0]);
+	}
+}
+
+static inline void get_random_bytes(void *buf, int nbytes)
+{
+	getrandom(buf, nbytes, 0);
+}
+
+static inline unsigned long copy_from_user(void *to, const void *from,
+											unsigned long n)
+{
+	memcpy(to, from, n);
+	return 0;
+}
+
+static inline uint64_t ktime_get_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/***************************************************************************
+ *				USER SPACE LIBRARY FUNCTIONS
+ **************************************************************************/
+
+/* set if the library was built with ENCRYPTION */
+extern const bool bispe_user_encryption;
+
+void bispe_user_set_password(const char *password);
+
+int bispe_user_encrypt_code(u8 *code, size_t size);
+
+void bispe_user_decrypt_seg(u8 *out, const u8 *seg, size_t size);
+
+#endif /* _BISPE_USER_H */
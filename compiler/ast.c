@@ -33,6 +33,34 @@ void set_max_arg_count(int i) {
 	max_arg_count = i;
 }
 
+// round stack frames to whole call lines
+static int line_frames = 0;
+
+void set_line_frames(int enable) {
+	line_frames = enable;
+}
+
+// returns the size of a stack frame with size dwords in use,
+// with line frames return address and frame fill whole lines of 4 dwords
+int frame_size_of(int size) {
+	if(line_frames) {
+		size = ((size + 1 + 3) & ~3) - 1;
+	}
+	return size;
+}
+
+// adds count local variables to the frame of func and returns the address
+// of the first one. the arguments above the frame move along
+int grow_frame(func_info *func, int count) {
+	int pos = func->max_call_size + func->var_count;
+	int old_size = func->frame_size;
+
+	func->var_count += count;
+	func->frame_size = frame_size_of(func->var_count + func->max_call_size);
+	move_vars(func, old_size + 1, func->frame_size - old_size);
+	return pos;
+}
+
 static node_t *alloc_node(void) {
 	node_t *node = malloc(sizeof(node_t));
 	if(node == NULL) {
@@ -209,7 +237,7 @@ static void calculate_arg_addresses(func_info *func, node_t *node) {
 		char *name = node->middle->val.str;
 		var_info *var = get_var(name, func);
 
-		var->pos = var->pos + func->var_count + func->max_call_size;
+		var->pos = var->pos + func->frame_size;
 
 	} else { // recursive parsing of arg tree
 		calculate_arg_addresses(func, node->left);
@@ -306,6 +334,9 @@ static node_t *register_function(node_t *node, node_t *children[]) {
 		return NULL;
 	}
 
+	// padding of line frames lies between local variables and return address
+	func->frame_size = frame_size_of(func->var_count + func->max_call_size);
+
 	// calculate addresses of argument variables
 	calculate_arg_addresses(func, arglist);
 
@@ -408,6 +439,34 @@ node_t *create_empty(void) {
 	return node;
 }
 
+// returns a deep copy of the subtree at node
+// symbol table entries in val are shared with the original
+node_t *copy_node(node_t *node) {
+	if(node == NULL) {
+		return NULL;
+	}
+
+	node_t *copy = alloc_node();
+	copy->type = node->type;
+	copy->val = node->val;
+	copy->left = copy_node(node->left);
+	copy->middle = copy_node(node->middle);
+	copy->right = copy_node(node->right);
+	return copy;
+}
+
+// returns the count of assignments to var in the subtree at node
+int count_assignments(node_t *node, var_info *var) {
+	if(node == NULL) {
+		return 0;
+	}
+
+	int count = (node->type == AST_VAR_DEF || node->type == AST_VAR_ASSIGN)
+		&& node->val.var == var;
+	return count + count_assignments(node->left, var)
+		+ count_assignments(node->middle, var) + count_assignments(node->right, var);
+}
+
 void cleanup_node(node_t *node) {
 	if(node == NULL) {
 		return;
@@ -31,6 +31,7 @@
 #include "ast.h"
 #include "generator.h"
 #include "lexer.h"
+#include "optimizer.h"
 #include "parser.h"
 #include "symbols.h"
 
@@ -45,7 +46,7 @@ struct buf_info {
 };
 
 static void print_usage(void) {
-	printf("usage: ./compiler [-u] [-s[op]] [-o <outfile>] <infile>\n");
+	printf("usage: ./compiler [-u] [-l] [-w] [-a] [-O<level>] [-funroll[-limit=<words>]] [-s[op]] [-o <outfile>] <infile>\n");
 }
 
 /* returns an newly allocated string containing the infile string
@@ -147,7 +148,10 @@ int main(int argc, char *argv[]) {
 	int show_mnemonics = 0;
 	int show_opcodes = 0;
 	int unencrypted = 0;
-	while((opt = getopt(argc, argv, "s::uo:")) != -1) {
+	int opt_level = 1;
+	int unroll = 0;
+	int unroll_limit = 32;
+	while((opt = getopt(argc, argv, "s::ulwaO:f:o:")) != -1) {
 		switch (opt) {
 			case 'o':
 				outfile = optarg;
@@ -169,6 +173,35 @@ int main(int argc, char *argv[]) {
 				unencrypted = 1;
 				printf("WARNING: your code will be saved unencrypted!\n");
 				break;
+			case 'l':
+				// round stack frames to whole call lines
+				set_line_frames(1);
+				break;
+			case 'w':
+				// every argument in a code word of its own, no short forms
+				set_wide_code(1);
+				break;
+			case 'a':
+				// align instructions and loops to the code lines
+				set_code_layout(1);
+				break;
+			case 'O':
+				// 0: no optimizations, 1: constant folding and peephole rules,
+				// 2: loop optimizations, inlining and tail calls as well
+				opt_level = atoi(optarg);
+				break;
+			case 'f':
+				// -funroll: unroll counted loops, -funroll-limit=<words>:
+				// code words an unrolled loop may take
+				if(strcmp(optarg, "unroll") == 0) {
+					unroll = 1;
+				} else if(strncmp(optarg, "unroll-limit=", 13) == 0) {
+					unroll_limit = atoi(optarg + 13);
+				} else {
+					print_usage();
+					goto out;
+				}
+				break;
 			default:
 				print_usage();
 				goto out;
@@ -180,6 +213,10 @@ int main(int argc, char *argv[]) {
 	}
 	infile = argv[optind];
 
+	set_peephole(opt_level >= 1);
+	set_tail_calls(opt_level >= 2);
+	set_unroll_limit(unroll ? unroll_limit : 0);
+
 	// open infile and read to string buffer
 	FILE *fp = fopen(infile, "r");
 	if(fp == NULL) {
@@ -210,6 +247,18 @@ int main(int argc, char *argv[]) {
 		goto parser_out;
 	}
 
+	// evaluate constant expressions at compile time
+	if(opt_level >= 1) {
+		fold_constants(ast_head);
+	}
+
+	// move loop invariant code out of loops, replace calls of small
+	// functions by their bodies
+	if(opt_level >= 2) {
+		optimize_loops(ast_head);
+		inline_functions(ast_head);
+	}
+
 	// generate code from ast
 	code_t *code_head = generate_code(ast_head);
 	if(code_head == NULL) {
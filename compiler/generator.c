@@ -36,6 +36,13 @@ struct code_t {
 	struct code_t *next;
 	instr_type instr;
 	uint32_t arg;
+	int long_form; // set by the layout, see layout_code
+	func_info *func; // function the instruction belongs to, NULL for the entry code
+	func_info *callee; // called function, its address is set when all code is generated
+
+	// used by the peephole optimizer, see peephole_code
+	struct code_t *target; // jump or call target, NULL for the end of the code
+	int refs; // count of jumps and calls to this instruction
 };
 
 static int error = 0;
@@ -46,6 +53,78 @@ static code_t *current = NULL;
 
 static func_info *current_func = NULL;
 
+// address of the current function's body, after the prolog
+static int body_addr = 0;
+
+// function whose body is inlined at the moment, see AST_INLINE
+static func_info *inline_func = NULL;
+
+// target of the jmp of a return in an inlined body, until the end is known
+#define INLINE_RET UINT32_MAX
+
+// keep every argument in a code word of its own, instead of short forms
+static int wide_code = 0;
+
+void set_wide_code(int enable) {
+	wide_code = enable;
+}
+
+// lay out the code for the line-wise decryption, see layout_code
+static int code_layout = 0;
+
+void set_code_layout(int enable) {
+	code_layout = enable;
+}
+
+static int peephole = 0;
+
+void set_peephole(int enable) {
+	peephole = enable;
+}
+
+static int tail_calls = 0;
+
+void set_tail_calls(int enable) {
+	tail_calls = enable;
+}
+
+// code words an unrolled loop may take, 0 to not unroll loops, see unroll_loop
+static int unroll_limit = 0;
+
+void set_unroll_limit(int words) {
+	unroll_limit = words;
+}
+
+static int is_jmp_instr(instr_type instr) {
+	return instr == INSTR_JMP || instr == INSTR_CALL
+		|| (instr >= INSTR_JEQ && instr <= INSTR_JGE);
+}
+
+// returns if the argument of an instruction goes to its short form.
+// jump and call targets always do, as their addresses are assigned
+// before the targets are known (build_codebuf checks that they fit)
+static int is_short(code_t *elem) {
+	if(wide_code || elem->long_form || !instr_info[elem->instr].has_arg) {
+		return 0;
+	}
+	if(is_jmp_instr(elem->instr)) {
+		return 1;
+	}
+	if(elem->instr == INSTR_PUSH) {
+		return (int32_t) elem->arg >= -(1 << 23)
+			&& (int32_t) elem->arg < (1 << 23);
+	}
+	return elem->arg < (1 << 24);
+}
+
+// returns the size of an instruction in code words
+static int instr_size(code_t *elem) {
+	if(instr_info[elem->instr].has_arg && !is_short(elem)) {
+		return 2;
+	}
+	return 1;
+}
+
 static instr_type boolop_to_jmp_instr(token_type type) {
 	switch(type) {
 		case TOK_EQEQ:
@@ -100,31 +179,274 @@ static code_t *push_elem(instr_type instr, uint32_t arg) {
 	elem->next = NULL;
 	elem->instr = instr;
 	elem->arg = arg;
+	elem->long_form = 0;
+	elem->func = current_func;
+	elem->callee = NULL;
 
 	if(current != NULL) {
 		current->next = elem;
 	}
 	current = elem;
 
-	size += 1;
-	if(instr_info[instr].has_arg) {
-		size += 1;
-	}
+	size += instr_size(elem);
 
 	return elem;
 }
 
+// pushes a call or jmp to func, which may not be generated yet
+static code_t *push_call(instr_type instr, func_info *func) {
+	code_t *elem = push_elem(instr, 0);
+	elem->callee = func;
+	return elem;
+}
+
 static void push_func_prolog(func_info *func) {
-	int frame_size = func->var_count + func->max_call_size;
-	if(frame_size > 0) {
-		push_elem(INSTR_PROLOG, frame_size);
+	if(func->frame_size > 0) {
+		push_elem(INSTR_PROLOG, func->frame_size);
 	}
 }
 
 static void push_func_epilog(func_info *func) {
-	int frame_size = func->var_count + func->max_call_size;
-	if(frame_size > 0) {
-		push_elem(INSTR_EPILOG, frame_size);
+	if(func->frame_size > 0) {
+		push_elem(INSTR_EPILOG, func->frame_size);
+	}
+}
+
+// returns the address of a variable in the frame of the current function.
+// the local variables and then the arguments of an inlined function
+// follow at the inline base of the function it is inlined in
+static uint32_t var_pos(var_info *var) {
+	if(inline_func == NULL) {
+		return var->pos;
+	} else if(var->pos < inline_func->frame_size) {
+		return current_func->inline_base + var->pos - inline_func->max_call_size;
+	}
+	return current_func->inline_base + inline_func->var_count
+		+ var->pos - inline_func->frame_size - 1;
+}
+
+static void generate_helper(node_t *node);
+
+// returns an expression without the unary expression nodes around it
+static node_t *strip(node_t *expr) {
+	while(expr != NULL && (expr->type == AST_EXPRESSION1
+			|| (expr->type == AST_EXPRESSION && expr->middle == NULL))) {
+		expr = expr->left;
+	}
+	return expr;
+}
+
+// Generates return f(...) as a jump to f, so that the call stack does not grow.
+// The arguments go to the addresses of the arguments of the current function,
+// where f expects them if the current function is left before. A call of the
+// current function itself jumps to its body right away, with the frame kept.
+// f cannot have more arguments than the current function.
+// returns 0 if expr is no such call
+static int generate_tail_call(node_t *expr) {
+	expr = strip(expr);
+	if(expr == NULL || expr->type != AST_RET_FCALL
+			|| expr->val.func->arg_count > current_func->arg_count) {
+		return 0;
+	}
+
+	func_info *callee = expr->val.func;
+	generate_helper(expr->left); // calculate arguments
+
+	for(int i = callee->arg_count-1; i >= 0; i--) {
+		push_elem(INSTR_STORE, current_func->frame_size + 1 + i);
+	}
+
+	if(callee == current_func) {
+		push_elem(INSTR_JMP, body_addr);
+	} else {
+		push_func_epilog(current_func);
+		push_call(INSTR_JMP, callee);
+	}
+	return 1;
+}
+
+// unroll loops at most this many times
+#define UNROLL_MAX 8
+
+// set while code is generated to be measured, see code_words
+static int measuring = 0;
+
+// returns the code words node is generated to, without keeping the code
+static int code_words(node_t *node) {
+	code_t *mark = current;
+	int mark_size = size;
+
+	measuring++;
+	generate_helper(node);
+	measuring--;
+	int words = size - mark_size;
+
+	cleanup_code(mark->next);
+	mark->next = NULL;
+	current = mark;
+	size = mark_size;
+	return words;
+}
+
+// returns the code words of an instruction which is not generated yet
+static int words_of(instr_type instr, uint32_t arg) {
+	code_t elem = { .instr = instr, .arg = arg };
+	return instr_size(&elem);
+}
+
+// returns if an expression has the same value throughout a loop, and
+// cannot call a function or fail
+static int is_fixed(node_t *node, node_t *loop) {
+	if(node == NULL) {
+		return 1;
+	} else if(node->type == AST_IDENTIFIER) {
+		return count_assignments(loop->middle, node->val.var) == 0
+			&& count_assignments(loop->left->right, node->val.var) == 0;
+	} else if(node->type == AST_RET_FCALL || (node->type == AST_NUMOP_LEAF
+			&& (node->val.type == TOK_SLASH || node->val.type == TOK_PERCENT))) {
+		return 0;
+	}
+	return is_fixed(node->left, loop) && is_fixed(node->middle, loop)
+		&& is_fixed(node->right, loop);
+}
+
+// returns if loop is for(...; i op bound; i = i + step) with a fixed bound
+// and a counter which only the increment changes, and the condition holds
+// for fewer values of i the further it counts (op is < or <= if the step
+// is positive, > or >= if it is negative)
+static int is_unrollable(node_t *loop, var_info **i, int32_t *step,
+		node_t **bound, instr_type *jmp) {
+	node_t *head = loop->left;
+	if(head->type != AST_FOR_LOOP_HEAD || head->right->type != AST_VAR_ASSIGN) {
+		return 0;
+	}
+
+	*i = head->right->val.var;
+	node_t *incr = strip(head->right->left);
+	if(incr == NULL || incr->type != AST_EXPRESSION) {
+		return 0;
+	}
+	token_type op = incr->middle->left->val.type;
+	node_t *a = strip(incr->left), *b = strip(incr->right);
+	if(op == TOK_PLUS && a->type == AST_INTLITERAL
+			&& b->type == AST_IDENTIFIER && b->val.var == *i) {
+		*step = a->val.number;
+	} else if((op == TOK_PLUS || op == TOK_MINUS) && a->type == AST_IDENTIFIER
+			&& a->val.var == *i && b->type == AST_INTLITERAL) {
+		*step = op == TOK_PLUS ? b->val.number : -(uint32_t) b->val.number;
+	} else {
+		return 0;
+	}
+
+	node_t *cond = head->middle;
+	node_t *counter = strip(cond->left);
+	node_t *boolop = cond->middle->type == AST_BOOLOP ? cond->middle->left : cond->middle;
+	*bound = cond->right;
+	*jmp = boolop_to_jmp_instr(boolop->val.type);
+	if(counter->type != AST_IDENTIFIER || counter->val.var != *i
+			|| count_assignments(loop->middle, *i) != 0 || !is_fixed(*bound, loop)) {
+		return 0;
+	}
+	return *step > 0 ? *jmp == INSTR_JL || *jmp == INSTR_JLE
+		: *step < 0 && (*jmp == INSTR_JG || *jmp == INSTR_JGE);
+}
+
+// Unrolls a counted for loop, see is_unrollable. After the init of the loop,
+// iterations run in groups of n copies of the body and the increment,
+// without the check of the condition and the jump back in between:
+// a group runs while i op bound - (n-1) * step holds, so that the condition
+// holds for every copy. The loop itself then runs the iterations left.
+// The group is checked against bound - (n-1) * step once before, which
+// fails if the subtraction wraps around, so that the loop runs them all.
+// The interpreter decrypts a code line at every jump back, and a new line
+// on the way down. n is chosen for the fewest lines decrypted per
+// iteration, so that the group fills its last line, with the group and
+// its check within the unroll limit.
+static void unroll_loop(node_t *loop) {
+	var_info *i;
+	int32_t step;
+	node_t *bound;
+	instr_type jmp;
+	if(!is_unrollable(loop, &i, &step, &bound, &jmp)) {
+		return;
+	}
+
+	int literal = strip(bound)->type == AST_INTLITERAL;
+	int32_t bound_value = literal ? strip(bound)->val.number : 0;
+	int body_words = code_words(loop->middle) + code_words(loop->left->right);
+	int bound_words = literal ? 0 : code_words(bound) + 1; // bound - span
+
+	int n = 1, words = 0;
+	for(int k = 2; k <= UNROLL_MAX; k++) {
+		// (k-1) * step, and the last i a group may start with if the bound is a literal
+		int64_t span = (int64_t) (k - 1) * step;
+		int64_t last = (int64_t) bound_value - span;
+		if(span != (int32_t) span || (literal && last != (int32_t) last)) {
+			break;
+		}
+
+		int check_words = words_of(INSTR_LOAD, var_pos(i))
+			+ words_of(INSTR_PUSH, literal ? last : span) + bound_words
+			+ words_of(jmp, 0);
+		int group_words = k * body_words + check_words;
+		if(group_words > unroll_limit) {
+			break;
+		}
+
+		// fewer lines per iteration: lines of k / k < lines of n / n
+		if(n == 1 || (group_words + 3) / 4 * n < (words + 3) / 4 * k) {
+			n = k;
+			words = group_words;
+		}
+	}
+
+	if(n == 1) {
+		if(!measuring) {
+			printf("unroll: %s: loop of %d code words not unrolled\n",
+				current_func->name, body_words);
+		}
+		return;
+	}
+	uint32_t span = (uint32_t) (n - 1) * step;
+
+	// the check before the groups, if the bound is no literal
+	code_t *check_instr = NULL;
+	if(!literal) {
+		generate_helper(bound);
+		push_elem(INSTR_PUSH, span);
+		push_elem(INSTR_SUB, 0);
+		generate_helper(bound);
+		// skip the groups if bound - span wraps around
+		check_instr = push_elem(step > 0 ? INSTR_JG : INSTR_JL, 0);
+	}
+
+	code_t *forward_jmp_instr = push_elem(INSTR_JMP, 0);
+	int back_jmp_target = size;
+
+	for(int k = 0; k < n; k++) {
+		generate_helper(loop->middle);
+		generate_helper(loop->left->right);
+	}
+
+	forward_jmp_instr->arg = size;
+	push_elem(INSTR_LOAD, var_pos(i));
+	if(literal) {
+		push_elem(INSTR_PUSH, bound_value - (int32_t) span);
+	} else {
+		generate_helper(bound);
+		push_elem(INSTR_PUSH, span);
+		push_elem(INSTR_SUB, 0);
+	}
+	push_elem(jmp, back_jmp_target);
+
+	if(check_instr != NULL) {
+		check_instr->arg = size;
+	}
+
+	if(!measuring) {
+		printf("unroll: %s: loop of %d code words unrolled %d times, "
+			"%d code words in %d lines per group\n",
+			current_func->name, body_words, n, words, (words + 3) / 4);
 	}
 }
 
@@ -135,7 +457,7 @@ static void generate_helper(node_t *node) {
 
 	switch(node->type) {
 		case AST_IDENTIFIER:
-			push_elem(INSTR_LOAD, node->val.var->pos);
+			push_elem(INSTR_LOAD, var_pos(node->val.var));
 			break;
 
 		case AST_INTLITERAL:
@@ -146,7 +468,7 @@ static void generate_helper(node_t *node) {
 		case AST_VAR_ASSIGN:
 			if(node->left != NULL) { // ignore pure variable definitions
 				generate_helper(node->left); // calculate value of assignment
-				push_elem(INSTR_STORE, node->val.var->pos);
+				push_elem(INSTR_STORE, var_pos(node->val.var));
 			}
 			break;
 
@@ -156,7 +478,16 @@ static void generate_helper(node_t *node) {
 			break;
 
 		case AST_RETURN:
+			if(tail_calls && inline_func == NULL && generate_tail_call(node->left)) {
+				break;
+			}
+
 			generate_helper(node->left);
+			if(inline_func != NULL) {
+				// the value stays on the stack, like after a call
+				push_elem(INSTR_JMP, INLINE_RET);
+				break;
+			}
 			push_func_epilog(current_func);
 			push_elem(INSTR_RET, 0);
 			break;
@@ -246,6 +577,9 @@ static void generate_helper(node_t *node) {
 			// if for-loop, generate loop variable initialization
 			if(loop_type == 1) {
 				generate_helper(node->left->left);
+				if(unroll_limit > 0) {
+					unroll_loop(node);
+				}
 			}
 
 			code_t *forward_jmp_instr;
@@ -288,14 +622,39 @@ static void generate_helper(node_t *node) {
 				push_elem(INSTR_STORE, i);
 			}
 
-			push_elem(INSTR_CALL, node->val.func->addr);
+			push_call(INSTR_CALL, node->val.func);
+			break;
+
+		case AST_INLINE:
+			generate_helper(node->left); // calculate arguments
+
+			// store arguments from stack to the frame addresses of the inlined function
+			inline_func = node->val.func;
+			for(int i = inline_func->arg_count-1; i >= 0; i--) {
+				push_elem(INSTR_STORE, current_func->inline_base + inline_func->var_count + i);
+			}
+
+			code_t *inline_start = current;
+			generate_helper(node->middle); // function body
+			inline_func = NULL;
+
+			// returns jump to the end of the body
+			for(code_t *cur = inline_start->next; cur != NULL; cur = cur->next) {
+				if(cur->instr == INSTR_JMP && cur->arg == INLINE_RET) {
+					cur->arg = size;
+				}
+			}
 			break;
 
 		case AST_FUNCTION:
+			if(node->val.func->inlined) { // no calls left
+				break;
+			}
 			current_func = node->val.func;
 			current_func->addr = size;
 
 			push_func_prolog(current_func);
+			body_addr = size;
 
 			// function body
 			generate_helper(node->left);
@@ -320,8 +679,10 @@ static void generate_helper(node_t *node) {
 
 			// if needed, allocate call stack space for program arguments
 			// we do not need to free this space, as the program halts anyway
-			if(main_func->arg_count > 0) {
-				push_elem(INSTR_PROLOG, main_func->arg_count);
+			// (with line frames, it also aligns the frame of main)
+			int entry_size = frame_size_of(main_func->arg_count);
+			if(entry_size > 0) {
+				push_elem(INSTR_PROLOG, entry_size);
 			}
 
 			// generate load instructions for program arguments
@@ -330,18 +691,13 @@ static void generate_helper(node_t *node) {
 			}
 
 			// add entry point call to main function
-			code_t *entry_point = push_elem(INSTR_CALL, 0);
+			push_call(INSTR_CALL, main_func);
 
 			// add instruction terminating the program
 			push_elem(INSTR_FINISH, 0);
 
 			// generate program
 			generate_helper(node->left);
-
-			// now, the address of main is known
-			// -> update entry point address to main address
-			entry_point->arg = main_func->addr;
-
 			break;
 
 		default:
@@ -351,6 +707,323 @@ static void generate_helper(node_t *node) {
 	}
 }
 
+// inserts a nop instruction in front of elem
+static void insert_nop(code_t *elem) {
+	code_t *nop = malloc(sizeof(code_t));
+	if(nop == NULL) {
+		fprintf(stderr, "generator: fatal error allocating element. exiting.\n");
+		cleanup_code(first);
+		exit(EXIT_FAILURE);
+	}
+
+	nop->instr = INSTR_NOP;
+	nop->arg = 0;
+	nop->long_form = 0;
+	nop->func = elem->func;
+	nop->callee = NULL;
+
+	nop->prev = elem->prev;
+	nop->next = elem;
+	if(elem->prev != NULL) {
+		elem->prev->next = nop;
+	} else {
+		first = nop;
+	}
+	elem->prev = nop;
+}
+
+// unlinks and frees elem, jumps to it go to the instruction after it
+static void remove_elem(code_t *elem) {
+	if(elem->refs > 0) {
+		for(code_t *cur = first; cur != NULL; cur = cur->next) {
+			if(is_jmp_instr(cur->instr) && cur->target == elem) {
+				cur->target = elem->next;
+			}
+		}
+		if(elem->next != NULL) {
+			elem->next->refs += elem->refs;
+		}
+	}
+
+	if(elem->prev != NULL) {
+		elem->prev->next = elem->next;
+	} else {
+		first = elem->next;
+	}
+	if(elem->next != NULL) {
+		elem->next->prev = elem->prev;
+	}
+	free(elem);
+}
+
+static void set_target(code_t *elem, code_t *target) {
+	if(elem->target != NULL) {
+		elem->target->refs--;
+	}
+	if(target != NULL) {
+		target->refs++;
+	}
+	elem->target = target;
+}
+
+// returns if the variable at pos is loaded anywhere in func but at except
+static int is_loaded(func_info *func, uint32_t pos, code_t *except) {
+	for(code_t *cur = first; cur != NULL; cur = cur->next) {
+		if(cur->func == func && cur != except
+				&& cur->instr == INSTR_LOAD && cur->arg == pos) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int is_func_start(code_t *elem) {
+	return elem->func != NULL && (elem->prev == NULL || elem->prev->func != elem->func);
+}
+
+// returns the number of instructions of func
+static int count_instrs(func_info *func) {
+	int count = 0;
+	for(code_t *cur = first; cur != NULL; cur = cur->next) {
+		count += cur->func == func;
+	}
+	return count;
+}
+
+// applies the peephole rules at elem, returns if the code was changed
+static int peephole_rules(code_t *elem) {
+	code_t *next = elem->next;
+
+	// jump to jmp -> jump to the target of the jmp
+	if(is_jmp_instr(elem->instr) && elem->instr != INSTR_CALL) {
+		code_t *target = elem->target;
+		for(int hops = 0; target != NULL && target->instr == INSTR_JMP
+				&& hops < 16; hops++) {
+			target = target->target;
+		}
+		// leave endless jmp loops alone
+		if(target != elem->target
+				&& (target == NULL || target->instr != INSTR_JMP)) {
+			set_target(elem, target);
+			return 1;
+		}
+	}
+
+	// jmp to the next instruction -> nothing
+	if(elem->instr == INSTR_JMP && elem->target == next) {
+		set_target(elem, NULL);
+		remove_elem(elem);
+		return 1;
+	}
+
+	// code after jmp, ret or finish up to the next jump target is
+	// never run, e.g. the epilog and ret after a return
+	if((elem->instr == INSTR_JMP || elem->instr == INSTR_RET
+			|| elem->instr == INSTR_FINISH)
+			&& next != NULL && next->refs == 0 && next->func == elem->func) {
+		if(is_jmp_instr(next->instr)) {
+			set_target(next, NULL);
+		}
+		remove_elem(next);
+		return 1;
+	}
+
+	// store x; load x -> nothing, if x is not loaded anywhere else.
+	// the value stays on the stack for the instruction after the load
+	if(elem->instr == INSTR_STORE && next != NULL && next->instr == INSTR_LOAD
+			&& next->arg == elem->arg && next->refs == 0 && elem->func != NULL
+			&& elem->arg >= elem->func->max_call_size
+			&& !is_loaded(elem->func, elem->arg, next)) {
+		remove_elem(next);
+		remove_elem(elem);
+		return 1;
+	}
+
+	return 0;
+}
+
+// Applies pattern rules on the instruction list until none matches any more.
+// Jump and call arguments are turned into pointers to their targets before,
+// and back into addresses after, so that instructions can be removed freely.
+// The instruction count before and after is reported per function.
+static void peephole_code(void) {
+	code_t **elem_at = calloc(size + 1, sizeof(code_t *)); // by address
+	if(elem_at == NULL) {
+		fprintf(stderr, "generator: fatal error allocating peephole. exiting.\n");
+		cleanup_code(first);
+		exit(EXIT_FAILURE);
+	}
+
+	// remember the functions in code order and their instruction counts
+	int funcs = 0, total_before = 0;
+	for(code_t *cur = first; cur != NULL; cur = cur->next) {
+		funcs += is_func_start(cur);
+		total_before++;
+	}
+	func_info **func_list = malloc((funcs + 1) * sizeof(func_info *));
+	int *before = malloc((funcs + 1) * sizeof(int));
+	if(func_list == NULL || before == NULL) {
+		fprintf(stderr, "generator: fatal error allocating peephole. exiting.\n");
+		cleanup_code(first);
+		exit(EXIT_FAILURE);
+	}
+
+	int addr = 0;
+	funcs = 0;
+	for(code_t *cur = first; cur != NULL; cur = cur->next) {
+		if(is_func_start(cur)) {
+			func_list[funcs] = cur->func;
+			before[funcs] = count_instrs(cur->func);
+			funcs++;
+		}
+		elem_at[addr] = cur;
+		cur->refs = 0;
+		addr += instr_size(cur);
+	}
+
+	for(code_t *cur = first; cur != NULL; cur = cur->next) {
+		cur->target = NULL;
+		if(is_jmp_instr(cur->instr)) {
+			set_target(cur, elem_at[cur->arg]);
+		}
+	}
+
+	int changed;
+	do {
+		changed = 0;
+		for(code_t *cur = first; cur != NULL; ) {
+			code_t *prev = cur->prev;
+			if(peephole_rules(cur)) {
+				changed = 1;
+				// go on in front of the change, a rule may match there now
+				cur = prev != NULL ? prev : first;
+			} else {
+				cur = cur->next;
+			}
+		}
+	} while(changed);
+
+	// give out the new addresses
+	addr = 0;
+	int total_after = 0;
+	for(code_t *cur = first; cur != NULL; cur = cur->next) {
+		addr += instr_size(cur);
+		total_after++;
+	}
+	size = addr;
+
+	for(code_t *cur = first; cur != NULL; cur = cur->next) {
+		if(is_jmp_instr(cur->instr)) {
+			addr = 0;
+			for(code_t *it = first; it != cur->target; it = it->next) {
+				addr += instr_size(it);
+			}
+			cur->arg = addr;
+		}
+	}
+
+	for(int i = 0; i < funcs; i++) {
+		printf("peephole: %s: %d -> %d instructions\n",
+			func_list[i]->name, before[i], count_instrs(func_list[i]));
+	}
+	printf("peephole: %d -> %d instructions, %d code words\n",
+		total_before, total_after, size);
+
+	free(elem_at);
+	free(func_list);
+	free(before);
+}
+
+// returns the number of code lines a loop from head to its jump back spans
+static int loop_lines(int head, int jmp_addr, code_t *jmp) {
+	return (jmp_addr + instr_size(jmp) - 1) / 4 - head / 4 + 1;
+}
+
+// The interpreter decrypts code in lines of 4 words. The layout makes sure
+// that no instruction has its argument in the line after its opcode, and
+// starts the bodies of loops (targets of backward jumps) at a line, so that
+// every iteration decrypts as few lines as possible.
+// An instruction which would start in the last word of a line is moved on
+// by the long form of the instruction before it if that one is short,
+// and otherwise by a nop. Loop bodies are moved on by nops, which are only
+// run when the loop is entered from above.
+// The nops make the code larger, and those between the instructions are run,
+// so the lines saved per loop iteration are reported along with the size.
+static void layout_code(void) {
+	int *new_addr = malloc((size + 1) * sizeof(int)); // by old address
+	char *loop_head = calloc(size + 1, 1);
+	if(new_addr == NULL || loop_head == NULL) {
+		fprintf(stderr, "generator: fatal error allocating layout. exiting.\n");
+		cleanup_code(first);
+		exit(EXIT_FAILURE);
+	}
+
+	// find the loops, and the lines they span before the layout
+	int addr = 0, loops = 0, lines_before = 0;
+	for(code_t *cur = first; cur != NULL; cur = cur->next) {
+		if(is_jmp_instr(cur->instr) && cur->instr != INSTR_CALL
+				&& cur->arg <= addr) {
+			loop_head[cur->arg] = 1;
+			loops++;
+			lines_before += loop_lines(cur->arg, addr, cur);
+		}
+		addr += instr_size(cur);
+	}
+
+	int old_addr = 0, nops = 0, long_forms = 0, aligned = 0;
+	addr = 0;
+	for(code_t *cur = first; cur != NULL; cur = cur->next) {
+		int pad = 0;
+		if(loop_head[old_addr] && addr % 4 != 0) {
+			pad = 4 - addr % 4;
+			aligned++;
+		} else if(instr_size(cur) == 2 && addr % 4 == 3) {
+			code_t *prev = cur->prev;
+			if(instr_info[prev->instr].has_arg && is_short(prev)) {
+				prev->long_form = 1;
+				long_forms++;
+				addr++;
+			} else {
+				pad = 1;
+			}
+		}
+
+		for(int i = 0; i < pad; i++) {
+			insert_nop(cur);
+		}
+		nops += pad;
+		addr += pad;
+
+		new_addr[old_addr] = addr;
+		old_addr += instr_size(cur);
+		addr += instr_size(cur);
+	}
+	new_addr[old_addr] = addr;
+
+	// move the jump and call targets along, and count the loop lines again
+	int lines_after = 0;
+	addr = 0;
+	for(code_t *cur = first; cur != NULL; cur = cur->next) {
+		if(is_jmp_instr(cur->instr)) {
+			cur->arg = new_addr[cur->arg];
+			if(cur->instr != INSTR_CALL && cur->arg <= addr) {
+				lines_after += loop_lines(cur->arg, addr, cur);
+			}
+		}
+		addr += instr_size(cur);
+	}
+
+	// code size against the lines decrypted per iteration of all loops
+	printf("layout: %d long forms and %d nops, %d of %d loops moved; "
+		"%d -> %d code words, loops span %d -> %d lines per iteration\n",
+		long_forms, nops, aligned, loops, size, addr,
+		lines_before, lines_after);
+
+	size = addr;
+	free(new_addr);
+	free(loop_head);
+}
+
 code_t *generate_code(node_t *head) {
 	generate_helper(head);
 
@@ -358,6 +1031,21 @@ code_t *generate_code(node_t *head) {
 		cleanup_code(first);
 		return NULL;
 	}
+
+	// now, the addresses of all functions are known
+	for(code_t *cur = first; cur != NULL; cur = cur->next) {
+		if(cur->callee != NULL) {
+			cur->arg = cur->callee->addr;
+		}
+	}
+
+	if(peephole) {
+		peephole_code();
+	}
+
+	if(code_layout) {
+		layout_code();
+	}
 	return first;
 }
 
@@ -401,10 +1089,12 @@ uint32_t *build_codebuf(code_t *head, size_t *len, int unencrypted) {
 
 	// count bytecode size
 	while(cur != NULL) {
-		size++;
-		if(instr_info[cur->instr].has_arg) {
-			size++;
+		if(!wide_code && is_jmp_instr(cur->instr) && cur->arg >= (1 << 24)) {
+			fprintf(stderr, "error: jump target %u does not fit in a short "
+				"instruction, compile with -w\n", cur->arg);
+			return NULL;
 		}
+		size += instr_size(cur);
 		cur = cur->next;
 	}
 
@@ -439,10 +1129,15 @@ uint32_t *build_codebuf(code_t *head, size_t *len, int unencrypted) {
 
 	// copy opcodes
 	while(cur != NULL) {
-		buf[pos++] = instr_info[cur->instr].opcode;
-
-		if(instr_info[cur->instr].has_arg) {
-			buf[pos++] = cur->arg;
+		if(is_short(cur)) {
+			buf[pos++] = (cur->arg << 8) | INSTR_SHORT
+				| instr_info[cur->instr].opcode;
+		} else {
+			buf[pos++] = instr_info[cur->instr].opcode;
+
+			if(instr_info[cur->instr].has_arg) {
+				buf[pos++] = cur->arg;
+			}
 		}
 
 		cur = cur->next;
@@ -470,18 +1165,21 @@ void print_code(code_t *head, int mode) {
 	uint32_t addr = 0;
 	code_t *cur = head;
 	while(cur != NULL) {
+		int is_short_form = is_short(cur);
 		printf("%4d: ", addr);
 		if(mode == 1) {
 			printf("%s", instr_info[cur->instr].name);
+		} else if(mode == 2 && is_short_form) {
+			printf("%08x", (cur->arg << 8) | INSTR_SHORT
+				| instr_info[cur->instr].opcode);
 		} else if(mode == 2) {
 			printf("%08x", instr_info[cur->instr].opcode);
 		}
-		if(instr_info[cur->instr].has_arg) {
+		if(instr_info[cur->instr].has_arg && (mode == 1 || !is_short_form)) {
 			printf("\t%08x", cur->arg);
-			addr += 1;
 		}
 		printf("\n");
+		addr += instr_size(cur);
 		cur = cur->next;
-		addr += 1;
 	}
 }
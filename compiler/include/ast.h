@@ -57,6 +57,7 @@ typedef enum {
 	AST_ARGDEFLIST,
 	AST_FUNCTION,
 	AST_FUNCTION_PROTO,
+	AST_INLINE, // inlined function call, middle is a copy of the function body
 } ast_type;
 
 typedef struct node_t {
@@ -74,6 +75,9 @@ typedef struct node_t {
 } node_t;
 
 void set_max_arg_count(int i);
+void set_line_frames(int enable);
+int frame_size_of(int size);
+int grow_frame(func_info *func, int count);
 
 node_t *create_identifier(token_t *token);
 node_t *create_intliteral(token_t *token);
@@ -84,6 +88,8 @@ node_t *create_type(token_t *token);
 
 node_t *create_node(ast_type type, node_t *children[], size_t len);
 node_t *create_empty(void);
+node_t *copy_node(node_t *node);
+int count_assignments(node_t *node, var_info *var);
 void cleanup_node(node_t *node);
 void print_ast(node_t *node, int level);
 
@@ -28,6 +28,16 @@
 
 typedef struct code_t code_t;
 
+void set_wide_code(int enable);
+
+void set_code_layout(int enable);
+
+void set_peephole(int enable);
+
+void set_tail_calls(int enable);
+
+void set_unroll_limit(int words);
+
 code_t *generate_code(node_t *head);
 
 void cleanup_code(code_t *elem);
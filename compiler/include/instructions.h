@@ -21,6 +21,11 @@
 #ifndef INSTRUCTIONS_H 
 #define INSTRUCTIONS_H
 
+// short form of an instruction with argument: the argument is kept in the
+// upper 24 bit of the opcode word, whose lower 8 bit are opcode | INSTR_SHORT
+// (the argument of push is sign extended)
+#define INSTR_SHORT 0x80
+
 struct instr_info {
 	const char *name;
 	int has_arg;
@@ -0,0 +1,33 @@
+/***************************************************************************
+ * optimizer.h
+ *
+ * Copyright (C) 2014-2016	Max Seitzer <maximilian.seitzer@fau.de>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place - Suite 330, Boston, MA 02111-1307 USA.
+ *
+ ***************************************************************************/
+
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "ast.h"
+
+void fold_constants(node_t *head);
+
+void optimize_loops(node_t *head);
+
+void inline_functions(node_t *head);
+
+#endif /* OPTIMIZER_H */
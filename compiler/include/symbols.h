@@ -43,8 +43,15 @@ typedef struct func_info {
 	int arg_count; // count of arguments
 	int var_count; // count of local variables
 	int max_call_size; // maximum amount of arguments from functions called by this function
+	int frame_size; // size of the stack frame on the call stack, without return address
+
+	int call_count; // count of call sites of this function, see inline_functions
+	int leaf; // this function calls no other function
+	int inlined; // all calls of this function are inlined, no code is generated for it
+	int inline_base; // frame address of the variables of functions inlined here
 
 	var_info *var_table[HASHTABLE_SIZE]; // variables declared in this function
+	var_info *temp_vars; // variables added by the optimizer, not in var_table
 
 	struct func_info *next;
 } func_info;
@@ -54,6 +61,8 @@ func_info *get_func(char *name);
 
 var_info *add_var(char *name, dtype ret_type, func_info *func);
 var_info *get_var(char *name, func_info *func);
+var_info *add_temp_var(dtype type, func_info *func);
+void move_vars(func_info *func, int from, int delta);
 
 void cleanup_symbols(void);
 void print_function_table(void);
@@ -0,0 +1,841 @@
+/***************************************************************************
+ * optimizer.c
+ *
+ * Copyright (C) 2014-2016	Max Seitzer <maximilian.seitzer@fau.de>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place - Suite 330, Boston, MA 02111-1307 USA.
+ *
+ ***************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "symbols.h"
+
+// functions with a body of at most this many instructions are inlined,
+// larger ones only if they are called from a single site
+#define INLINE_MAX_SIZE 12
+
+static node_t *create(ast_type type, node_t *left, node_t *middle) {
+	node_t *node = malloc(sizeof(node_t));
+	if(node == NULL) {
+		fprintf(stderr, "optimizer: fatal error allocating node. exiting.\n");
+		exit(EXIT_FAILURE);
+	}
+	node->type = type;
+	node->left = left;
+	node->middle = middle;
+	node->right = NULL;
+	return node;
+}
+
+static node_t *create_literal(uint32_t value) {
+	node_t *node = create(AST_INTLITERAL, NULL, NULL);
+	node->val.number = value;
+	return node;
+}
+
+// returns the operator of a binary expression, TOK_EOF for all other nodes
+static token_type op_of(node_t *node) {
+	if(node == NULL || node->type != AST_EXPRESSION || node->middle == NULL) {
+		return TOK_EOF;
+	}
+	return node->middle->left->val.type;
+}
+
+static void set_op(node_t *node, token_type op) {
+	node->middle->left->val.type = op;
+}
+
+static int is_literal(node_t *node, uint32_t value) {
+	return node->type == AST_INTLITERAL && (uint32_t) node->val.number == value;
+}
+
+// an expression may only be dropped if evaluating it cannot call a function
+// or fail with a division by zero
+static int is_pure(node_t *node) {
+	if(node == NULL) {
+		return 1;
+	} else if(node->type == AST_RET_FCALL) {
+		return 0;
+	}
+
+	token_type op = op_of(node);
+	if((op == TOK_SLASH || op == TOK_PERCENT)
+		&& (node->right->type != AST_INTLITERAL || node->right->val.number == 0)) {
+		return 0;
+	}
+	return is_pure(node->left) && is_pure(node->right);
+}
+
+// calculates a op b like the interpreter does: 32 bit wraparound and
+// unsigned division. returns 0 on a division by zero, which is left
+// to the interpreter to report at runtime
+static int calculate(token_type op, uint32_t a, uint32_t b, uint32_t *res) {
+	switch(op) {
+		case TOK_PLUS:
+			*res = a + b;
+			break;
+		case TOK_MINUS:
+			*res = a - b;
+			break;
+		case TOK_STAR:
+			*res = a * b;
+			break;
+		case TOK_SLASH:
+			if(b == 0) {
+				return 0;
+			}
+			*res = a / b;
+			break;
+		case TOK_PERCENT:
+			if(b == 0) {
+				return 0;
+			}
+			*res = a % b;
+			break;
+		default:
+			return 0;
+	}
+	return 1;
+}
+
+// replaces node with the literal value
+static node_t *to_literal(node_t *node, uint32_t value) {
+	cleanup_node(node->left);
+	cleanup_node(node->middle);
+	cleanup_node(node->right);
+	node->type = AST_INTLITERAL;
+	node->val.number = value;
+	node->left = NULL;
+	node->middle = NULL;
+	node->right = NULL;
+	return node;
+}
+
+// replaces node with its operand *keep
+static node_t *to_operand(node_t *node, node_t **keep) {
+	node_t *res = *keep;
+	*keep = NULL;
+	cleanup_node(node);
+	return res;
+}
+
+// splits the operand of an expression with operator op into k + sign * *rest,
+// if it is a literal (*rest is NULL) or an expression with a literal operand
+// that can be reassociated with op. returns 0 otherwise
+static int split_operand(node_t *node, token_type op, uint32_t *k, node_t ***rest,
+		int *sign) {
+	int additive = op == TOK_PLUS || op == TOK_MINUS;
+	token_type inner = op_of(node);
+
+	*rest = NULL;
+	*sign = 1;
+	if(node->type == AST_INTLITERAL) {
+		*k = node->val.number;
+		return 1;
+	} else if(additive ? inner != TOK_PLUS && inner != TOK_MINUS : inner != op) {
+		return 0;
+	}
+
+	if(node->left->type == AST_INTLITERAL) { // k op y
+		*k = node->left->val.number;
+		*rest = &node->right;
+		*sign = inner == TOK_MINUS ? -1 : 1;
+	} else if(node->right->type == AST_INTLITERAL) { // y op k
+		*k = node->right->val.number;
+		*rest = &node->left;
+		if(inner == TOK_MINUS) {
+			*k = -*k;
+		}
+	} else {
+		return 0;
+	}
+	return 1;
+}
+
+// folds the literals of the binary expression node into one, if the other
+// operand is an expression with a literal as well, e.g. 1 + (x - 2) -> -1 + x
+// returns NULL if there is nothing to fold
+static node_t *reassociate(node_t *node) {
+	token_type op = op_of(node);
+	if(op != TOK_PLUS && op != TOK_MINUS && op != TOK_STAR) {
+		return NULL;
+	}
+
+	uint32_t kl, kr;
+	node_t **restl, **restr;
+	int signl, signr;
+	if(!split_operand(node->left, op, &kl, &restl, &signl)
+		|| !split_operand(node->right, op, &kr, &restr, &signr)
+		|| (restl == NULL) == (restr == NULL)) {
+		return NULL;
+	}
+
+	// detach the remaining operand y, the rest of the tree is rebuilt
+	uint32_t k;
+	int sign;
+	node_t *y;
+	if(op == TOK_STAR) {
+		k = kl * kr;
+		sign = 1;
+	} else if(op == TOK_MINUS) {
+		k = kl - kr;
+		sign = restl != NULL ? signl : -signr;
+	} else {
+		k = kl + kr;
+		sign = restl != NULL ? signl : signr;
+	}
+	if(restl != NULL) {
+		y = *restl;
+		*restl = NULL;
+	} else {
+		y = *restr;
+		*restr = NULL;
+	}
+
+	cleanup_node(node->left);
+	cleanup_node(node->right);
+	node->left = create_literal(k);
+	node->right = y;
+	if(op != TOK_STAR) {
+		set_op(node, sign > 0 ? TOK_PLUS : TOK_MINUS);
+	}
+	return node;
+}
+
+// simplifies a binary expression with folded operands
+static node_t *simplify(node_t *node) {
+	token_type op = op_of(node);
+	node_t *l = node->left;
+	node_t *r = node->right;
+
+	uint32_t res;
+	if(l->type == AST_INTLITERAL && r->type == AST_INTLITERAL) {
+		if(calculate(op, l->val.number, r->val.number, &res)) {
+			return to_literal(node, res);
+		}
+		return node;
+	}
+
+	if(reassociate(node) != NULL) {
+		return simplify(node);
+	}
+
+	switch(op) {
+		case TOK_PLUS:
+			if(is_literal(l, 0)) {
+				return to_operand(node, &node->right);
+			}
+			// fall through
+		case TOK_MINUS:
+			if(is_literal(r, 0)) {
+				return to_operand(node, &node->left);
+			}
+			if(op == TOK_MINUS && l->type == AST_IDENTIFIER
+				&& r->type == AST_IDENTIFIER && l->val.var == r->val.var) {
+				return to_literal(node, 0);
+			}
+			break;
+
+		case TOK_STAR:
+			if(is_literal(l, 1)) {
+				return to_operand(node, &node->right);
+			} else if(is_literal(r, 1)) {
+				return to_operand(node, &node->left);
+			} else if((is_literal(l, 0) && is_pure(r)) || (is_literal(r, 0) && is_pure(l))) {
+				return to_literal(node, 0);
+			}
+
+			// x * 2 -> x + x, an add is cheaper than a mul and a load
+			// takes the same code as a push
+			if(is_literal(l, 2) && r->type == AST_IDENTIFIER) {
+				cleanup_node(l);
+				node->left = copy_node(r);
+				set_op(node, TOK_PLUS);
+			} else if(is_literal(r, 2) && l->type == AST_IDENTIFIER) {
+				cleanup_node(r);
+				node->right = copy_node(l);
+				set_op(node, TOK_PLUS);
+			}
+			break;
+
+		case TOK_SLASH:
+			if(is_literal(r, 1)) {
+				return to_operand(node, &node->left);
+			}
+			break;
+
+		case TOK_PERCENT:
+			if(is_literal(r, 1) && is_pure(l)) {
+				return to_literal(node, 0);
+			}
+			break;
+
+		default:
+			break;
+	}
+	return node;
+}
+
+// folds all expressions below node, bottom up
+// returns the node replacing node in its parent
+static node_t *fold_node(node_t *node) {
+	if(node == NULL) {
+		return NULL;
+	}
+
+	// drop unary and single operand expression nodes, the
+	// generator handles their operand the same way
+	if(node->type == AST_EXPRESSION1
+		|| (node->type == AST_EXPRESSION && node->middle == NULL)) {
+		return fold_node(to_operand(node, &node->left));
+	}
+
+	node->left = fold_node(node->left);
+	node->middle = fold_node(node->middle);
+	node->right = fold_node(node->right);
+
+	if(op_of(node) != TOK_EOF) {
+		return simplify(node);
+	}
+	return node;
+}
+
+// evaluates literal arithmetic at compile time and simplifies expressions
+// with neutral or absorbing operands
+void fold_constants(node_t *head) {
+	fold_node(head);
+}
+
+// function definitions of the program, for the inliner
+static node_t **functions = NULL;
+static int function_count = 0;
+
+static void collect_functions(node_t *node) {
+	if(node == NULL) {
+		return;
+	} else if(node->type == AST_FUNCTION) {
+		if(functions != NULL) {
+			functions[function_count] = node;
+		}
+		function_count++;
+		return;
+	}
+
+	collect_functions(node->left);
+	collect_functions(node->middle);
+	collect_functions(node->right);
+}
+
+static node_t *body_of(func_info *func) {
+	for(int i = 0; i < function_count; i++) {
+		if(functions[i]->val.func == func) {
+			return functions[i]->left;
+		}
+	}
+	return NULL;
+}
+
+// estimated count of instructions generated for node
+static int code_size(node_t *node) {
+	if(node == NULL) {
+		return 0;
+	}
+
+	int size = 0;
+	switch(node->type) {
+		case AST_IDENTIFIER:
+		case AST_INTLITERAL:
+		case AST_NUMOP_LEAF:
+		case AST_BOOLOP_LEAF:
+		case AST_PRINT:
+		case AST_LOOP:
+			size = 1;
+			break;
+		case AST_RETURN:
+			size = 2; // epilog and ret
+			break;
+		case AST_VAR_DEF:
+		case AST_VAR_ASSIGN:
+			size = node->left != NULL; // store
+			break;
+		case AST_BRANCH:
+			size = node->right != NULL; // jmp over the else branch
+			break;
+		case AST_FCALL:
+		case AST_RET_FCALL:
+			size = node->val.func->arg_count + 1;
+			break;
+		default:
+			break;
+	}
+	return size + code_size(node->left) + code_size(node->middle) + code_size(node->right);
+}
+
+// counts the call sites in node for the callees, returns if there are any
+static int count_calls(node_t *node) {
+	if(node == NULL) {
+		return 0;
+	}
+
+	int calls = 0;
+	if(node->type == AST_FCALL || node->type == AST_RET_FCALL) {
+		node->val.func->call_count++;
+		calls = 1;
+	}
+	calls |= count_calls(node->left);
+	calls |= count_calls(node->middle);
+	calls |= count_calls(node->right);
+	return calls;
+}
+
+// Leaf functions cannot be recursive, and an inlined body makes no calls
+// which would need the frame of the caller. main is never inlined.
+static int is_inlinable(func_info *func) {
+	node_t *body = body_of(func);
+	return func->leaf && body != NULL && strcmp(func->name, "main") != 0
+		&& (code_size(body) <= INLINE_MAX_SIZE || func->call_count == 1);
+}
+
+// turns the calls of inlinable functions below node into inlined calls,
+// returns the count of frame addresses the inlined functions need in caller
+static int inline_calls(node_t *node) {
+	if(node == NULL) {
+		return 0;
+	}
+
+	int slots = inline_calls(node->left); // arguments may be inlined as well
+	int slots_middle = inline_calls(node->middle);
+	int slots_right = inline_calls(node->right);
+	if(slots_middle > slots) {
+		slots = slots_middle;
+	}
+	if(slots_right > slots) {
+		slots = slots_right;
+	}
+
+	if((node->type == AST_FCALL || node->type == AST_RET_FCALL)
+			&& is_inlinable(node->val.func)) {
+		func_info *callee = node->val.func;
+
+		node->type = AST_INLINE;
+		node->middle = copy_node(body_of(callee));
+		callee->call_count--;
+
+		// the inlined bodies run one after another, so they share the addresses
+		if(callee->var_count + callee->arg_count > slots) {
+			slots = callee->var_count + callee->arg_count;
+		}
+	}
+	return slots;
+}
+
+// Replaces the calls of small leaf functions by a copy of their bodies,
+// which saves the call, prolog, epilog and ret, and the call stack lines
+// they touch. The arguments and local variables of an inlined function get
+// addresses in the frame of the caller, see grow_frame. Functions with all
+// their calls inlined are left out of the code.
+void inline_functions(node_t *head) {
+	function_count = 0;
+	collect_functions(head);
+	functions = malloc((function_count + 1) * sizeof(node_t *));
+	int *calls_before = malloc((function_count + 1) * sizeof(int));
+	if(functions == NULL || calls_before == NULL) {
+		fprintf(stderr, "optimizer: fatal error allocating function list. exiting.\n");
+		exit(EXIT_FAILURE);
+	}
+	function_count = 0;
+	collect_functions(head);
+
+	// build the call graph
+	for(int i = 0; i < function_count; i++) {
+		func_info *func = functions[i]->val.func;
+		func->leaf = !count_calls(functions[i]->left);
+	}
+	for(int i = 0; i < function_count; i++) {
+		calls_before[i] = functions[i]->val.func->call_count;
+	}
+
+	for(int i = 0; i < function_count; i++) {
+		func_info *func = functions[i]->val.func;
+		int slots = inline_calls(functions[i]->left);
+		if(slots > 0) {
+			func->inline_base = grow_frame(func, slots);
+		}
+	}
+
+	for(int i = 0; i < function_count; i++) {
+		func_info *func = functions[i]->val.func;
+		if(calls_before[i] > func->call_count) {
+			func->inlined = func->call_count == 0;
+			printf("inline: %s: %d of %d calls inlined%s\n", func->name,
+				calls_before[i] - func->call_count, calls_before[i],
+				func->inlined ? ", no code left" : "");
+		}
+	}
+
+	free(functions);
+	functions = NULL;
+	free(calls_before);
+}
+
+// functions whose loops are optimized at the moment
+static func_info *loop_func = NULL;
+
+// statements to put in front of the loop optimized at the moment
+static node_t *pre_head = NULL;
+static node_t **pre_tail = NULL;
+
+static int hoisted = 0, reduced = 0, kept = 0;
+
+static node_t *create_var(var_info *var) {
+	node_t *node = create(AST_IDENTIFIER, NULL, NULL);
+	node->val.var = var;
+	return node;
+}
+
+static node_t *create_assign(var_info *var, node_t *expr) {
+	node_t *node = create(AST_VAR_ASSIGN, expr, NULL);
+	node->val.var = var;
+	return node;
+}
+
+static node_t *create_expr(node_t *left, token_type op, node_t *right) {
+	node_t *op_leaf = create(AST_NUMOP_LEAF, NULL, NULL);
+	op_leaf->val.type = op;
+	node_t *node = create(AST_EXPRESSION, left, create(AST_NUMOP, op_leaf, NULL));
+	node->right = right;
+	return node;
+}
+
+static void append_pre(node_t *stmt) {
+	*pre_tail = create(AST_SEQUENCE, stmt, NULL);
+	pre_tail = &(*pre_tail)->middle;
+}
+
+// returns a new variable in the frame of the current function
+static var_info *create_temp(void) {
+	var_info *var = add_temp_var(DTYPE_INT, loop_func);
+	var->pos = grow_frame(loop_func, 1);
+	return var;
+}
+
+// compares two expressions
+static int same_tree(node_t *a, node_t *b) {
+	if(a == NULL || b == NULL) {
+		return a == b;
+	} else if(a->type != b->type) {
+		return 0;
+	} else if(a->type == AST_INTLITERAL && a->val.number != b->val.number) {
+		return 0;
+	} else if(a->type == AST_IDENTIFIER && a->val.var != b->val.var) {
+		return 0;
+	} else if(a->type == AST_NUMOP_LEAF && a->val.type != b->val.type) {
+		return 0;
+	}
+	return same_tree(a->left, b->left) && same_tree(a->middle, b->middle)
+		&& same_tree(a->right, b->right);
+}
+
+// an expression is loop invariant if it reads no variable assigned in the
+// loop, and it may be moved in front of the loop if it cannot fail
+static int is_invariant(node_t *node, node_t *loop) {
+	if(node->type == AST_INTLITERAL) {
+		return 1;
+	} else if(node->type == AST_IDENTIFIER) {
+		return count_assignments(loop, node->val.var) == 0;
+	}
+
+	token_type op = op_of(node);
+	if(op == TOK_EOF || ((op == TOK_SLASH || op == TOK_PERCENT)
+			&& (node->right->type != AST_INTLITERAL || node->right->val.number == 0))) {
+		return 0;
+	}
+	return is_invariant(node->left, loop) && is_invariant(node->right, loop);
+}
+
+// replaces the invariant expressions below *link by variables, which are
+// assigned in front of the loop. equal expressions share a variable
+static void hoist_invariants(node_t **link, node_t *loop) {
+	node_t *node = *link;
+	if(node == NULL) {
+		return;
+	}
+
+	if(op_of(node) == TOK_EOF || !is_invariant(node, loop)) {
+		hoist_invariants(&node->left, loop);
+		hoist_invariants(&node->middle, loop);
+		hoist_invariants(&node->right, loop);
+		return;
+	}
+
+	var_info *temp = NULL;
+	for(node_t *it = pre_head; it != NULL && temp == NULL; it = it->middle) {
+		if(it->left->type == AST_VAR_ASSIGN && same_tree(it->left->left, node)) {
+			temp = it->left->val.var;
+		}
+	}
+
+	if(temp == NULL) {
+		temp = create_temp();
+		append_pre(create_assign(temp, node));
+		hoisted++;
+	} else {
+		cleanup_node(node);
+	}
+	*link = create_var(temp);
+}
+
+// returns if node is the product i * k with a literal k (*square = 0),
+// or i * i (*square = 1)
+static int is_product(node_t *node, var_info *i, int *square, uint32_t *k) {
+	if(op_of(node) != TOK_STAR) {
+		return 0;
+	}
+
+	node_t *l = node->left;
+	node_t *r = node->right;
+	if(r->type == AST_IDENTIFIER && r->val.var == i) {
+		node_t *swap = l;
+		l = r;
+		r = swap;
+	}
+	if(l->type != AST_IDENTIFIER || l->val.var != i) {
+		return 0;
+	}
+
+	*square = r->type == AST_IDENTIFIER && r->val.var == i;
+	if(r->type == AST_INTLITERAL) {
+		*k = r->val.number;
+	}
+	return *square || r->type == AST_INTLITERAL;
+}
+
+// counts the products of a kind below node, or replaces them by temp
+static int find_products(node_t **link, var_info *i, int square, uint32_t k,
+		var_info *temp) {
+	node_t *node = *link;
+	if(node == NULL) {
+		return 0;
+	}
+
+	int node_square;
+	uint32_t node_k = 0;
+	if(is_product(node, i, &node_square, &node_k)
+			&& node_square == square && (square || node_k == k)) {
+		if(temp != NULL) {
+			cleanup_node(node);
+			*link = create_var(temp);
+		}
+		return 1;
+	}
+	return find_products(&node->left, i, square, k, temp)
+		+ find_products(&node->middle, i, square, k, temp)
+		+ find_products(&node->right, i, square, k, temp);
+}
+
+// returns the first product with i below node not in the rejected kinds
+static node_t *next_product(node_t *node, var_info *i, int rejected_count,
+		int rejected_square[], uint32_t rejected_k[]) {
+	if(node == NULL) {
+		return NULL;
+	}
+
+	int square;
+	uint32_t k = 0;
+	if(is_product(node, i, &square, &k)) {
+		int rejected = 0;
+		for(int j = 0; j < rejected_count; j++) {
+			rejected |= rejected_square[j] == square && (square || rejected_k[j] == k);
+		}
+		if(!rejected) {
+			return node;
+		}
+	}
+
+	node_t *res = next_product(node->left, i, rejected_count, rejected_square, rejected_k);
+	if(res == NULL) {
+		res = next_product(node->middle, i, rejected_count, rejected_square, rejected_k);
+	}
+	if(res == NULL) {
+		res = next_product(node->right, i, rejected_count, rejected_square, rejected_k);
+	}
+	return res;
+}
+
+// returns if the for loop counts a variable *i in steps of a literal *step,
+// and assigns it nowhere else
+static int is_counted_loop(node_t *loop, var_info **i, uint32_t *step) {
+	node_t *head = loop->left;
+	if(head->type != AST_FOR_LOOP_HEAD || head->right->type != AST_VAR_ASSIGN) {
+		return 0;
+	}
+
+	node_t *incr = head->right->left;
+	token_type op = op_of(incr);
+	*i = head->right->val.var;
+	if(op == TOK_PLUS && incr->left->type == AST_INTLITERAL
+			&& incr->right->type == AST_IDENTIFIER && incr->right->val.var == *i) {
+		*step = incr->left->val.number;
+	} else if((op == TOK_PLUS || op == TOK_MINUS)
+			&& incr->left->type == AST_IDENTIFIER && incr->left->val.var == *i
+			&& incr->right->type == AST_INTLITERAL) {
+		*step = op == TOK_PLUS ? incr->right->val.number : -incr->right->val.number;
+	} else {
+		return 0;
+	}
+
+	return count_assignments(head->middle, *i) == 0
+		&& count_assignments(loop->middle, *i) == 0;
+}
+
+// Strength reduction of the products of the counter i of a for loop:
+// t = i * k is kept up to date with t = t + step * k, and t = i * i with
+// t = t + d, where d = 2 * step * i + step * step is updated by d = d + 2 * step * step.
+// A product saves two instructions (load, mul) per use in every iteration,
+// while the updates cost four (and eight for i * i) in every iteration, so
+// a product is only reduced if it is used often enough.
+static void reduce_products(node_t *loop) {
+	var_info *i;
+	uint32_t step;
+	if(!is_counted_loop(loop, &i, &step)) {
+		return;
+	}
+
+	node_t *head = loop->left;
+	int rejected_count = 0;
+	int rejected_square[16];
+	uint32_t rejected_k[16];
+
+	node_t *product;
+	while(rejected_count < 16 && ((product = next_product(head->middle, i,
+			rejected_count, rejected_square, rejected_k)) != NULL
+			|| (product = next_product(loop->middle, i,
+			rejected_count, rejected_square, rejected_k)) != NULL)) {
+		int square;
+		uint32_t k = 0;
+		is_product(product, i, &square, &k);
+
+		int uses = find_products(&head->middle, i, square, k, NULL)
+			+ find_products(&loop->middle, i, square, k, NULL);
+		if(2 * uses <= (square ? 8 : 4)) {
+			rejected_square[rejected_count] = square;
+			rejected_k[rejected_count] = k;
+			rejected_count++;
+			kept++;
+			continue;
+		}
+
+		// the products are set up after the counter is
+		if(head->left != NULL) {
+			append_pre(head->left);
+			head->left = NULL;
+		}
+
+		var_info *t = create_temp();
+		append_pre(create_assign(t, copy_node(product)));
+		find_products(&head->middle, i, square, k, t);
+		find_products(&loop->middle, i, square, k, t);
+
+		// updates go in front of the increment of i
+		if(square) {
+			var_info *d = create_temp();
+			append_pre(create_assign(d, create_expr(
+				create_expr(create_literal(2 * step), TOK_STAR, create_var(i)),
+				TOK_PLUS, create_literal(step * step))));
+			head->right = create(AST_SEQUENCE, create_assign(d, create_expr(
+				create_var(d), TOK_PLUS, create_literal(2 * step * step))), head->right);
+			head->right = create(AST_SEQUENCE, create_assign(t, create_expr(
+				create_var(t), TOK_PLUS, create_var(d))), head->right);
+		} else {
+			head->right = create(AST_SEQUENCE, create_assign(t, create_expr(
+				create_var(t), TOK_PLUS, create_literal(step * k))), head->right);
+		}
+		reduced++;
+	}
+}
+
+// optimizes the loop at *link and the loops nested in it
+static void optimize_loops_helper(node_t **link) {
+	node_t *node = *link;
+	if(node == NULL) {
+		return;
+	}
+
+	if(node->type == AST_LOOP) {
+		pre_head = NULL;
+		pre_tail = &pre_head;
+
+		reduce_products(node);
+		if(node->left->type == AST_FOR_LOOP_HEAD) { // the initialization runs once
+			hoist_invariants(&node->left->middle, node);
+			hoist_invariants(&node->left->right, node);
+		} else {
+			hoist_invariants(&node->left, node);
+		}
+		hoist_invariants(&node->middle, node);
+
+		if(pre_head != NULL) {
+			*pre_tail = node;
+			*link = pre_head;
+		}
+	}
+
+	optimize_loops_helper(&node->left);
+	optimize_loops_helper(&node->middle);
+	optimize_loops_helper(&node->right);
+}
+
+// Moves the loop invariant expressions of loops in front of them, and
+// replaces products of loop counters by variables updated along with
+// the counter, see reduce_products.
+// The loops are optimized from the outside in, so that an expression is
+// moved out of as many loops as possible. The new variables are added to
+// the frame of the function.
+void optimize_loops(node_t *head) {
+	function_count = 0;
+	collect_functions(head);
+	functions = malloc((function_count + 1) * sizeof(node_t *));
+	if(functions == NULL) {
+		fprintf(stderr, "optimizer: fatal error allocating function list. exiting.\n");
+		exit(EXIT_FAILURE);
+	}
+	function_count = 0;
+	collect_functions(head);
+
+	for(int i = 0; i < function_count; i++) {
+		loop_func = functions[i]->val.func;
+		hoisted = 0;
+		reduced = 0;
+		kept = 0;
+
+		optimize_loops_helper(&functions[i]->left);
+
+		if(hoisted + reduced + kept > 0) {
+			printf("loops: %s: %d invariant expressions moved, "
+				"%d of %d counter products reduced\n",
+				loop_func->name, hoisted, reduced, reduced + kept);
+		}
+	}
+
+	free(functions);
+	functions = NULL;
+	loop_func = NULL;
+}
@@ -84,6 +84,13 @@ func_info *add_func(char *name, dtype ret_type) {
 	new_func->arg_count = 0;
 	new_func->var_count = 0;
 	new_func->max_call_size = 0;
+	new_func->frame_size = 0;
+
+	new_func->call_count = 0;
+	new_func->leaf = 0;
+	new_func->inlined = 0;
+	new_func->inline_base = 0;
+	new_func->temp_vars = NULL;
 
 	sglib_hashed_var_info_init(new_func->var_table);
 
@@ -117,6 +124,23 @@ var_info *add_var(char *name, dtype ret_type, func_info *func) {
 	return new_var;
 }
 
+/* adds a variable without a name to func, the caller sets its address */
+var_info *add_temp_var(dtype type, func_info *func) {
+	var_info *new_var = malloc(sizeof(var_info));
+	if(new_var == NULL) {
+		fprintf(stderr, "symbols: fatal error allocating symbol table entry. exiting.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	new_var->name = "";
+	new_var->type = type;
+	new_var->pos = 0;
+
+	new_var->next = func->temp_vars;
+	func->temp_vars = new_var;
+	return new_var;
+}
+
 func_info *get_func(char *name) {
 	func_info func = { .name = name };
 	return sglib_hashed_func_info_find_member(func_table, &func);
@@ -127,6 +151,18 @@ var_info *get_var(char *name, func_info *func) {
 	return sglib_hashed_var_info_find_member(func->var_table, &var);
 }
 
+/* moves all variables of func at address from or above by delta */
+void move_vars(func_info *func, int from, int delta) {
+	struct sglib_hashed_var_info_iterator var_it;
+	for(var_info *var = sglib_hashed_var_info_it_init(&var_it, func->var_table);
+			var != NULL;
+			var = sglib_hashed_var_info_it_next(&var_it)) {
+		if(var->pos >= from) {
+			var->pos += delta;
+		}
+	}
+}
+
 /* iterates over function table and the contained variable tables and frees allocated space */
 void cleanup_symbols(void) {
 	struct sglib_hashed_func_info_iterator func_it;
@@ -142,6 +178,12 @@ void cleanup_symbols(void) {
 			free(var);
 		}
 
+		for(var_info *var = func->temp_vars; var != NULL; ) {
+			var_info *next = var->next;
+			free(var);
+			var = next;
+		}
+
 		free(func);
 	}
 }
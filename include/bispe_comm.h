@@ -59,4 +59,32 @@ struct invoke_ctx {
 	struct buf_info out_buf;
 };
 
+/*
+ * Points in time during an invoke, recorded if the backend is built with
+ * STATS=1. The phases of an invoke are the times between two consecutive
+ * events, the kernel module reports them in ns for the last invoke in
+ * /sys/kernel/bispe/stats (one line, in the order of the events below).
+ */
+enum invoke_event {
+	/* sysfs store handler entered */
+	INVOKE_ENTER,
+	/* code and arguments copied from user space (get_buf_from_user) */
+	INVOKE_COPIED_IN,
+	/* runtime context and segments allocated */
+	INVOKE_ALLOCATED,
+	/* interpreter thread started (kthread_run) and begins execution */
+	INVOKE_EXEC_BEGIN,
+	/* program halted */
+	INVOKE_EXEC_END,
+	/* thread creator woken up by the interpreter thread (semaphore) */
+	INVOKE_WOKEN,
+	/* interpreter thread stopped (kthread_stop) */
+	INVOKE_STOPPED,
+	/* output and result copied to user space */
+	INVOKE_COPIED_OUT,
+	/* memory freed and interpreter unlocked */
+	INVOKE_DONE,
+	INVOKE_EVENTS
+};
+
 #endif /* _BISPE_COMM_H */
\ No newline at end of file
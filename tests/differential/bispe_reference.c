@@ -0,0 +1,528 @@
+/***************************************************************************
+ * bispe_reference.c
+ * Reference implementation of the bispe instruction set in plain C
+ *
+ * Copyright (C) 2014-2016	Max Seitzer <maximilian.seitzer@fau.de>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place - Suite 330, Boston, MA 02111-1307 USA.
+ *
+ ***************************************************************************/
+
+/*
+ * This implementation follows the assembly instruction cycle in
+ * backend/asm_instructions.S instruction by instruction, including the order
+ * in which errors are detected. It works on plain dword arrays instead of
+ * encrypted lines, which makes the following properties of the line based
+ * implementation visible as undefined values:
+ *  - stack elements above the stack pointer are lost on pop, as the stack
+ *    line is not written back when the previous line is fetched
+ *  - call lines above the line of the call pointer are garbled on decrease,
+ *    as the CBC chain is only reencrypted up to the call pointer
+ *  - popping the last element reads stack element 0, which only holds a value
+ *    if an arithmetic instruction wrote its result there
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bispe_defines.h"
+#include "bispe_reference.h"
+
+/* immediates are multiplied by 4 in 32 bit registers by the interpreter */
+#define IMM_MASK 0x3FFFFFFF
+
+#define LINE(idx) ((idx) / 4)
+
+struct ref_state {
+	const uint32_t *code;
+	size_t code_len;
+
+	const uint32_t *argv;
+	size_t argc;
+
+	size_t ip;
+	size_t sp;
+	size_t cp;
+	size_t pp;
+
+	struct ref_seg *stack;
+	struct ref_seg *call;
+	struct ref_seg *print;
+
+	/* set if a value decided about control flow, but was undefined */
+	int undefined;
+
+	/* set if the current instruction is a short form, see INSTR_SHORT */
+	int short_form;
+	uint32_t short_imm;
+};
+
+static int seg_alloc(struct ref_seg *seg, size_t len) {
+	seg->len = len;
+	seg->val = calloc(len, sizeof(uint32_t));
+	seg->def = calloc(len, sizeof(uint8_t));
+
+	return (seg->val == NULL || seg->def == NULL) ? -1 : 0;
+}
+
+static void seg_free(struct ref_seg *seg) {
+	free(seg->val);
+	free(seg->def);
+	seg->val = NULL;
+	seg->def = NULL;
+}
+
+/*
+ * fetches the immediate following the current instruction,
+ * or of a short form from its opcode word
+ */
+static int fetch_imm(struct ref_state *st, uint32_t *imm) {
+	if(st->short_form) {
+		*imm = st->short_imm;
+		return 0;
+	}
+
+	st->ip++;
+	if(st->ip >= st->code_len) {
+		/* the interpreter would read behind the code segment */
+		st->undefined = 1;
+		return -1;
+	}
+
+	*imm = st->code[st->ip];
+	return 0;
+}
+
+static uint8_t check_jmp_target(struct ref_state *st, uint32_t target) {
+	return (target >= st->code_len) ? ERR_JMP_BOUNDS : 0;
+}
+
+/***************************************************************************
+ *				STACK
+ **************************************************************************/
+
+static uint8_t push(struct ref_state *st, uint32_t val, uint8_t def) {
+	if(st->sp + 1 >= st->stack->len) {
+		return ERR_STACK_OVERFLOW;
+	}
+
+	st->sp++;
+	st->stack->val[st->sp] = val;
+	st->stack->def[st->sp] = def;
+	return 0;
+}
+
+/* extracts top element, then decreases stack pointer like extr/dec_stack_ptr */
+static uint8_t pop(struct ref_state *st, uint32_t *val, uint8_t *def) {
+	*val = st->stack->val[st->sp];
+	*def = st->stack->def[st->sp];
+
+	if(st->sp == 0) {
+		return ERR_STACK_UNDERFLOW;
+	}
+
+	st->stack->def[st->sp] = 0;
+	st->sp--;
+	return 0;
+}
+
+/***************************************************************************
+ *				CALL STACK
+ **************************************************************************/
+
+static uint8_t call_idx(struct ref_state *st, uint32_t disp, size_t *idx) {
+	disp &= IMM_MASK;
+	if(disp > st->cp) {
+		return ERR_CALL_UNDERFLOW;
+	}
+
+	*idx = st->cp - disp;
+	return 0;
+}
+
+static uint8_t inc_call_ptr(struct ref_state *st, uint32_t amount) {
+	st->cp += amount & IMM_MASK;
+	if(st->cp >= st->call->len) {
+		return ERR_CALL_OVERFLOW;
+	}
+
+	return 0;
+}
+
+static uint8_t dec_call_ptr(struct ref_state *st, uint32_t amount) {
+	size_t old_cp = st->cp;
+
+	amount &= IMM_MASK;
+	if(amount > st->cp) {
+		return ERR_CALL_UNDERFLOW;
+	}
+	st->cp -= amount;
+
+	/* lines above the new call line may get garbled */
+	size_t end = (LINE(old_cp) + 1) * 4;
+	for(size_t i = (LINE(st->cp) + 1) * 4; i < end && i < st->call->len; i++) {
+		st->call->def[i] = 0;
+	}
+
+	return 0;
+}
+
+/***************************************************************************
+ *				INSTRUCTIONS
+ **************************************************************************/
+
+static uint8_t arith(struct ref_state *st, uint32_t op) {
+	uint32_t top, second, res = 0;
+	uint8_t top_def, second_def, err;
+
+	if((err = pop(st, &top, &top_def)) != 0) {
+		return err;
+	}
+	second = st->stack->val[st->sp];
+	second_def = st->stack->def[st->sp];
+
+	if(op == INSTR_DIV || op == INSTR_MOD) {
+		if(!top_def) {
+			st->undefined = 1;
+			return 0;
+		}
+		if(top == 0) {
+			return ERR_DIV_ZERO;
+		}
+	}
+
+	switch(op) {
+		case INSTR_ADD: res = second + top; break;
+		case INSTR_SUB: res = second - top; break;
+		case INSTR_MUL: res = second * top; break;
+		case INSTR_DIV: res = second / top; break;
+		case INSTR_MOD: res = second % top; break;
+	}
+
+	st->stack->val[st->sp] = res;
+	st->stack->def[st->sp] = top_def && second_def;
+	return 0;
+}
+
+static uint8_t cond_jmp(struct ref_state *st, uint32_t op) {
+	uint32_t top, second;
+	uint8_t top_def, second_def, err;
+
+	if((err = pop(st, &top, &top_def)) != 0) {
+		return err;
+	}
+	if((err = pop(st, &second, &second_def)) != 0) {
+		return err;
+	}
+	if(!top_def || !second_def) {
+		st->undefined = 1;
+		return 0;
+	}
+
+	int32_t a = (int32_t) second, b = (int32_t) top;
+	int taken = 0;
+	switch(op) {
+		case INSTR_JEQ: taken = a == b; break;
+		case INSTR_JNE: taken = a != b; break;
+		case INSTR_JL: taken = a < b; break;
+		case INSTR_JLE: taken = a <= b; break;
+		case INSTR_JG: taken = a > b; break;
+		case INSTR_JGE: taken = a >= b; break;
+	}
+
+	uint32_t target;
+	if(fetch_imm(st, &target) != 0) {
+		return 0;
+	}
+
+	if(!taken) {
+		st->ip++;
+		return 0;
+	}
+
+	if((err = check_jmp_target(st, target)) != 0) {
+		return err;
+	}
+	st->ip = target;
+	return 0;
+}
+
+/* returns whether the instruction has an immediate, and thus a short form */
+static int has_imm(uint32_t op) {
+	switch(op) {
+		case INSTR_PUSH:
+		case INSTR_LOAD:
+		case INSTR_STORE:
+		case INSTR_JMP:
+		case INSTR_JEQ:
+		case INSTR_JNE:
+		case INSTR_JL:
+		case INSTR_JLE:
+		case INSTR_JG:
+		case INSTR_JGE:
+		case INSTR_CALL:
+		case INSTR_PROLOG:
+		case INSTR_EPILOG:
+		case INSTR_ARGLOAD:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/* executes one instruction, returns error code */
+static uint8_t step(struct ref_state *st, int *finished) {
+	uint32_t op = st->code[st->ip];
+	uint32_t imm, val;
+	uint8_t def, err;
+	size_t idx;
+
+	/* a long form with upper bits set falls through to the default case */
+	st->short_form = (op & INSTR_SHORT) != 0;
+	if(st->short_form) {
+		if(!has_imm(op & 0x7F)) {
+			return ERR_INV_OPCODE;
+		}
+		/* the constant of push is sign extended */
+		if((op & 0x7F) == INSTR_PUSH) {
+			st->short_imm = (uint32_t) ((int32_t) op >> 8);
+		} else {
+			st->short_imm = op >> 8;
+		}
+		op &= 0x7F;
+	}
+
+	switch(op) {
+		case INSTR_NOP:
+			st->ip++;
+			return 0;
+
+		case INSTR_FINISH:
+			*finished = 1;
+			return 0;
+
+		case INSTR_PUSH:
+			if(fetch_imm(st, &imm) != 0) {
+				return 0;
+			}
+			if((err = push(st, imm, 1)) != 0) {
+				return err;
+			}
+			st->ip++;
+			return 0;
+
+		case INSTR_PRINT:
+			if((err = pop(st, &val, &def)) != 0) {
+				return err;
+			}
+			st->print->val[st->pp] = val;
+			st->print->def[st->pp] = def;
+			st->pp++;
+			if(st->pp == st->print->len) {
+				st->pp = 0;
+			}
+			st->ip++;
+			return 0;
+
+		case INSTR_LOAD:
+			if(fetch_imm(st, &imm) != 0) {
+				return 0;
+			}
+			if((err = call_idx(st, imm, &idx)) != 0) {
+				return err;
+			}
+			if((err = push(st, st->call->val[idx], st->call->def[idx])) != 0) {
+				return err;
+			}
+			st->ip++;
+			return 0;
+
+		case INSTR_STORE:
+			if(fetch_imm(st, &imm) != 0) {
+				return 0;
+			}
+			if((err = pop(st, &val, &def)) != 0) {
+				return err;
+			}
+			if((err = call_idx(st, imm, &idx)) != 0) {
+				return err;
+			}
+			st->call->val[idx] = val;
+			st->call->def[idx] = def;
+			st->ip++;
+			return 0;
+
+		case INSTR_ADD:
+		case INSTR_SUB:
+		case INSTR_MUL:
+		case INSTR_DIV:
+		case INSTR_MOD:
+			if((err = arith(st, op)) != 0) {
+				return err;
+			}
+			st->ip++;
+			return 0;
+
+		case INSTR_JMP:
+			if(fetch_imm(st, &imm) != 0) {
+				return 0;
+			}
+			if((err = check_jmp_target(st, imm)) != 0) {
+				return err;
+			}
+			st->ip = imm;
+			return 0;
+
+		case INSTR_JEQ:
+		case INSTR_JNE:
+		case INSTR_JL:
+		case INSTR_JLE:
+		case INSTR_JG:
+		case INSTR_JGE:
+			return cond_jmp(st, op);
+
+		case INSTR_CALL:
+			if(fetch_imm(st, &imm) != 0) {
+				return 0;
+			}
+			if((err = check_jmp_target(st, imm)) != 0) {
+				return err;
+			}
+			if((err = inc_call_ptr(st, 1)) != 0) {
+				return err;
+			}
+			/* return address is the instruction after the call */
+			st->call->val[st->cp] = st->ip + 1;
+			st->call->def[st->cp] = 1;
+			st->ip = imm;
+			return 0;
+
+		case INSTR_RET:
+			val = st->call->val[st->cp];
+			if(!st->call->def[st->cp]) {
+				st->undefined = 1;
+				return 0;
+			}
+			if((err = check_jmp_target(st, val)) != 0) {
+				return err;
+			}
+			if((err = dec_call_ptr(st, 1)) != 0) {
+				return err;
+			}
+			st->ip = val;
+			return 0;
+
+		case INSTR_PROLOG:
+			if(fetch_imm(st, &imm) != 0) {
+				return 0;
+			}
+			if((err = inc_call_ptr(st, imm)) != 0) {
+				return err;
+			}
+			st->ip++;
+			return 0;
+
+		case INSTR_EPILOG:
+			if(fetch_imm(st, &imm) != 0) {
+				return 0;
+			}
+			if((err = dec_call_ptr(st, imm)) != 0) {
+				return err;
+			}
+			st->ip++;
+			return 0;
+
+		case INSTR_ARGLOAD:
+			if(fetch_imm(st, &imm) != 0) {
+				return 0;
+			}
+			if(imm >= st->argc) {
+				return ERR_ARG_RANGE;
+			}
+			if((err = call_idx(st, imm, &idx)) != 0) {
+				return err;
+			}
+			st->call->val[idx] = st->argv[imm];
+			st->call->def[idx] = 1;
+			st->ip++;
+			return 0;
+
+		default:
+			return ERR_INV_OPCODE;
+	}
+}
+
+/*
+ * Runs code (without init vector) on the reference interpreter.
+ * Returns -1 if memory could not be allocated, 0 otherwise.
+ */
+int ref_run(const uint32_t *code, size_t code_len,
+			const uint32_t *argv, size_t argc,
+			const struct ref_config *config, struct ref_result *result) {
+	memset(result, 0, sizeof(*result));
+
+	if(seg_alloc(&result->stack, config->stack_size * 4) != 0
+		|| seg_alloc(&result->call, config->call_size * 4) != 0
+		|| seg_alloc(&result->print, config->print_size) != 0) {
+		ref_cleanup(result);
+		return -1;
+	}
+
+	struct ref_state st = {
+		.code = code,
+		.code_len = code_len,
+		.argv = argv,
+		.argc = argc,
+		.stack = &result->stack,
+		.call = &result->call,
+		.print = &result->print,
+	};
+
+	int finished = 0;
+	uint8_t err = 0;
+
+	result->status = REF_STEP_LIMIT;
+	while(result->steps < config->max_steps) {
+		if(st.ip >= st.code_len) {
+			st.undefined = 1;
+			break;
+		}
+
+		result->steps++;
+		err = step(&st, &finished);
+
+		if(st.undefined || err != 0 || finished) {
+			result->status = REF_DONE;
+			break;
+		}
+	}
+
+	if(st.undefined) {
+		result->status = REF_UNDEFINED;
+	}
+
+	result->error_code = err;
+	result->instr_idx = st.ip;
+	result->stack_idx = st.sp;
+	result->call_idx = st.cp;
+	result->print_idx = st.pp;
+
+	return 0;
+}
+
+void ref_cleanup(struct ref_result *result) {
+	seg_free(&result->stack);
+	seg_free(&result->call);
+	seg_free(&result->print);
+}
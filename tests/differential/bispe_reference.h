@@ -0,0 +1,82 @@
+/***************************************************************************
+ * bispe_reference.h
+ *
+ * Copyright (C) 2014-2016	Max Seitzer <maximilian.seitzer@fau.de>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place - Suite 330, Boston, MA 02111-1307 USA.
+ *
+ ***************************************************************************/
+
+#ifndef _BISPE_REFERENCE_H
+#define _BISPE_REFERENCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* outcome of a reference run */
+enum ref_status {
+	/* program finished or stopped with an interpreter error */
+	REF_DONE,
+	/* behaviour depends on undefined values, nothing can be compared */
+	REF_UNDEFINED,
+	/* program did not finish within the step limit */
+	REF_STEP_LIMIT,
+};
+
+/*
+ * Segment of the reference interpreter. Every element carries a flag if its
+ * value is defined. Values read from memory which was never written are
+ * garbage in the real interpreter (random data after decryption), so they
+ * are not defined in the reference.
+ */
+struct ref_seg {
+	uint32_t *val;
+	uint8_t *def;
+	size_t len;
+};
+
+struct ref_config {
+	/* segment sizes like in struct invoke_ctx: 128 bit lines for stack/call */
+	size_t stack_size;
+	size_t call_size;
+	/* print segment size in dwords */
+	size_t print_size;
+
+	size_t max_steps;
+};
+
+struct ref_result {
+	enum ref_status status;
+	uint8_t error_code;
+
+	/* final pointers as dword index into their segments */
+	size_t instr_idx;
+	size_t stack_idx;
+	size_t call_idx;
+	size_t print_idx;
+
+	struct ref_seg stack;
+	struct ref_seg call;
+	struct ref_seg print;
+
+	size_t steps;
+};
+
+int ref_run(const uint32_t *code, size_t code_len,
+			const uint32_t *argv, size_t argc,
+			const struct ref_config *config, struct ref_result *result);
+
+void ref_cleanup(struct ref_result *result);
+
+#endif /* _BISPE_REFERENCE_H */
@@ -0,0 +1,673 @@
+/***************************************************************************
+ * differential.c
+ * Differential test of the assembly interpreter against the reference
+ *
+ * Copyright (C) 2014-2016	Max Seitzer <maximilian.seitzer@fau.de>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place - Suite 330, Boston, MA 02111-1307 USA.
+ *
+ ***************************************************************************/
+
+/*
+ * Runs programs on the user space build of the interpreter (libbispe_user)
+ * and on the reference implementation, and compares error codes, print
+ * output and, if the program finished, the final pointers and the defined
+ * elements of stack and call stack.
+ * Whether the engine runs encrypted depends on the library linked against.
+ * The best engine the CPU supports is tested, --no-avx512 and --no-vaes
+ * select the engines below it instead. Programs which pass the verification
+ * at load run on its unchecked variant, unless --no-verify is given.
+ *
+ * Random mode generates random programs, compiled mode runs unencrypted
+ * executables (compiled with -u) with several instructions per cycle.
+ */
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bispe_user.h"
+#include "bispe_comm.h"
+#include "bispe_crypto.h"
+#include "bispe_defines.h"
+#include "bispe_interpreter.h"
+#include "bispe_state.h"
+
+#include "bispe_reference.h"
+
+#define MAX_RANDOM_LEN 160
+#define RANDOM_MAX_STEPS 20000
+#define COMPILED_MAX_STEPS 2000000000UL
+
+/* seconds until the engine is considered to hang */
+#define ENGINE_TIMEOUT 20
+
+static const char usage[] =
+	"usage: ./differential [-s <seed>] [-n <count>] [-v] [--no-avx512] [--no-vaes] "
+	"[--no-verify]\n"
+	"       ./differential -c [--stack-size=<size>] [--call-size=<size>] "
+	"[--no-avx512] [--no-vaes] [--no-verify] <executable> [args...]";
+
+static struct option cmd_options[] = {
+	{"stack-size", required_argument, NULL, 0x1},
+	{"call-size", required_argument, NULL, 0x2},
+	{"no-avx512", no_argument, NULL, 0x3},
+	{"no-vaes", no_argument, NULL, 0x4},
+	{"no-verify", no_argument, NULL, 0x5},
+	{NULL, 0, NULL, 0}
+};
+
+struct test_case {
+	uint32_t *code;
+	size_t code_len;
+	uint32_t argv[8];
+	size_t argc;
+	struct ref_config config;
+	uint64_t ipc;
+};
+
+struct engine_result {
+	uint8_t error_code;
+	size_t instr_idx;
+	size_t stack_idx;
+	size_t call_idx;
+	size_t print_idx;
+	uint32_t *stack;
+	uint32_t *call;
+	uint32_t *print;
+};
+
+static int verbose = 0;
+
+/* name of the instruction cycle under test */
+static const char *engine_name;
+
+static void timeout_handler(int sig) {
+	static const char msg[] = "engine timed out\n";
+	write(STDERR_FILENO, msg, sizeof(msg) - 1);
+	_exit(2);
+}
+
+/***************************************************************************
+ *				ENGINE
+ **************************************************************************/
+
+static int run_engine(const struct test_case *tc, struct engine_result *res) {
+	size_t code_bytes = tc->code_len * sizeof(uint32_t);
+	int ret = -1;
+
+	/* leave space for the init vector */
+	uint8_t *buf = malloc(code_bytes + 16);
+	if(buf == NULL) {
+		return -1;
+	}
+	memcpy(buf + 16, tc->code, code_bytes);
+
+	struct invoke_ctx invoke_ctx = {
+		.stack_size = tc->config.stack_size,
+		.call_size = tc->config.call_size,
+		.ipc = tc->ipc,
+		.code_buf = { buf + 16, code_bytes },
+		.arg_buf = { (void *) tc->argv, tc->argc * sizeof(uint32_t) },
+		.out_buf = { NULL, tc->config.print_size * sizeof(uint32_t) }
+	};
+
+	if(bispe_user_encryption) {
+		get_random_bytes(buf, 16);
+		if(bispe_user_encrypt_code(buf, code_bytes + 16) != 0) {
+			goto out;
+		}
+		invoke_ctx.code_buf.ptr = buf;
+		invoke_ctx.code_buf.size += 16;
+	}
+
+	struct runtime_ctx *runtime_ctx = init_interpreter_intern(&invoke_ctx);
+	if(runtime_ctx == NULL) {
+		goto out;
+	}
+
+	alarm(ENGINE_TIMEOUT);
+	res->error_code = start_interpreter(runtime_ctx, 0);
+	alarm(0);
+
+	res->instr_idx = bispe_get_instr_ptr() - bispe_code_seg_bp;
+	res->stack_idx = bispe_get_stack_ptr() - bispe_stack_seg_bp;
+	res->call_idx = bispe_get_call_ptr() - bispe_call_seg_bp;
+	res->print_idx = bispe_get_print_ptr() - bispe_print_seg_bp;
+
+	res->stack = malloc(bispe_stack_seg_size);
+	res->call = malloc(bispe_call_seg_size);
+	res->print = malloc(bispe_print_seg_size);
+
+	if(res->stack != NULL && res->call != NULL && res->print != NULL) {
+		bispe_user_decrypt_seg((u8 *) res->stack, (u8 *) bispe_stack_seg_bp,
+								bispe_stack_seg_size);
+		bispe_user_decrypt_seg((u8 *) res->call, (u8 *) bispe_call_seg_bp,
+								bispe_call_seg_size);
+		memcpy(res->print, bispe_print_seg_bp, bispe_print_seg_size);
+		ret = 0;
+	}
+
+	cleanup_runtime_ctx(runtime_ctx);
+out:
+	free(buf);
+	return ret;
+}
+
+static void engine_cleanup(struct engine_result *res) {
+	free(res->stack);
+	free(res->call);
+	free(res->print);
+}
+
+/***************************************************************************
+ *				COMPARISON
+ **************************************************************************/
+
+static int compare_seg(const char *name, const struct ref_seg *seg,
+						const uint32_t *vals, size_t len) {
+	int mismatches = 0;
+
+	for(size_t i = 0; i < len && i < seg->len; i++) {
+		if(seg->def[i] && seg->val[i] != vals[i]) {
+			printf("  %s[%zu]: reference %d, engine %d\n",
+				name, i, (int32_t) seg->val[i], (int32_t) vals[i]);
+			mismatches++;
+		}
+	}
+
+	return mismatches;
+}
+
+static int compare_idx(const char *name, size_t ref, size_t engine) {
+	if(ref != engine) {
+		printf("  %s: reference %zu, engine %zu\n", name, ref, engine);
+		return 1;
+	}
+	return 0;
+}
+
+/* returns the number of differences */
+static int compare(const struct ref_result *ref, const struct engine_result *res) {
+	int diff = 0;
+
+	if(ref->error_code != res->error_code) {
+		printf("  error code: reference %d, engine %d\n",
+			ref->error_code, res->error_code);
+		diff++;
+	}
+
+	/* print output is written to memory immediately, even on errors */
+	diff += compare_idx("print pointer", ref->print_idx, res->print_idx);
+	diff += compare_seg("print", &ref->print, res->print, ref->print.len);
+
+	/* on errors, the interpreter state is not saved */
+	if(ref->error_code != 0 || res->error_code != 0) {
+		return diff;
+	}
+
+	diff += compare_idx("instruction pointer", ref->instr_idx, res->instr_idx);
+	diff += compare_idx("stack pointer", ref->stack_idx, res->stack_idx);
+	diff += compare_idx("call pointer", ref->call_idx, res->call_idx);
+
+	if(diff == 0) {
+		diff += compare_seg("stack", &ref->stack, res->stack, ref->stack_idx + 1);
+		diff += compare_seg("call", &ref->call, res->call, ref->call_idx + 1);
+	}
+
+	return diff;
+}
+
+static void dump_case(const struct test_case *tc) {
+	printf("  stack size %zu, call size %zu, print size %zu, ipc %lu, args:",
+		tc->config.stack_size, tc->config.call_size, tc->config.print_size,
+		(unsigned long) tc->ipc);
+	for(size_t i = 0; i < tc->argc; i++) {
+		printf(" %d", (int32_t) tc->argv[i]);
+	}
+	printf("\n  code:");
+	for(size_t i = 0; i < tc->code_len; i++) {
+		printf("%s%08x", (i % 8 == 0) ? "\n    " : " ", tc->code[i]);
+	}
+	printf("\n");
+}
+
+/*
+ * Runs a test case on both interpreters.
+ * Returns -1 on failures, 0 if equal, 1 if the case could not be compared.
+ */
+static int run_case(const struct test_case *tc, struct ref_result *ref) {
+	struct engine_result res = {0};
+	int ret;
+
+	if(ref_run(tc->code, tc->code_len, tc->argv, tc->argc, &tc->config, ref) != 0) {
+		fprintf(stderr, "error: reference run failed\n");
+		return -1;
+	}
+
+	/* the engine would loop or behave randomly, skip */
+	if(ref->status != REF_DONE) {
+		return 1;
+	}
+
+	if(run_engine(tc, &res) != 0) {
+		fprintf(stderr, "error: engine run failed\n");
+		ret = -1;
+	} else {
+		ret = (compare(ref, &res) == 0) ? 0 : -1;
+	}
+
+	engine_cleanup(&res);
+	return ret;
+}
+
+/***************************************************************************
+ *				RANDOM PROGRAMS
+ **************************************************************************/
+
+struct opcode_weight {
+	uint32_t opcode;
+	int weight;
+};
+
+static const struct opcode_weight opcode_weights[] = {
+	{ INSTR_NOP, 2 }, { INSTR_FINISH, 1 },
+	{ INSTR_PUSH, 18 }, { INSTR_PRINT, 6 },
+	{ INSTR_LOAD, 10 }, { INSTR_STORE, 8 },
+	{ INSTR_ADD, 4 }, { INSTR_SUB, 4 }, { INSTR_MUL, 4 },
+	{ INSTR_DIV, 2 }, { INSTR_MOD, 2 },
+	{ INSTR_JMP, 3 }, { INSTR_JEQ, 1 }, { INSTR_JNE, 1 }, { INSTR_JL, 1 },
+	{ INSTR_JLE, 1 }, { INSTR_JG, 1 }, { INSTR_JGE, 1 },
+	{ INSTR_CALL, 4 }, { INSTR_RET, 3 },
+	{ INSTR_PROLOG, 4 }, { INSTR_EPILOG, 3 },
+	{ INSTR_ARGLOAD, 2 },
+	/* illegal opcode */
+	{ INSTR_ARGLOAD + 1, 1 },
+};
+
+static uint32_t rand32(void) {
+	return ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+}
+
+static uint32_t random_opcode(void) {
+	int total = 0;
+	for(size_t i = 0; i < ARRAY_SIZE(opcode_weights); i++) {
+		total += opcode_weights[i].weight;
+	}
+
+	int r = rand() % total;
+	for(size_t i = 0; i < ARRAY_SIZE(opcode_weights); i++) {
+		r -= opcode_weights[i].weight;
+		if(r < 0) {
+			uint32_t op = opcode_weights[i].opcode;
+			if(op <= INSTR_ARGLOAD) {
+				return op;
+			}
+			/* also long forms with upper bits and invalid short forms */
+			return (rand() % 2) ? op + rand32() % 64 : rand32();
+		}
+	}
+	return INSTR_NOP;
+}
+
+/* mostly small immediates, sometimes anything */
+static uint32_t random_imm(uint32_t range) {
+	switch(rand() % 16) {
+		case 0: return rand32();
+		case 1: return -(rand() % 4);
+		default: return rand() % range;
+	}
+}
+
+static void random_case(struct test_case *tc, uint32_t *code) {
+	size_t len = 0;
+	size_t n = 4 + rand() % (MAX_RANDOM_LEN - 16);
+
+	/*
+	 * Half of the programs have valid opcodes and jump to instructions only,
+	 * so that they pass the verification (see bispe_verify_code).
+	 */
+	int aligned = rand() % 2;
+	size_t starts[MAX_RANDOM_LEN], targets[MAX_RANDOM_LEN];
+	size_t n_starts = 0, n_targets = 0;
+	int short_targets[MAX_RANDOM_LEN];
+
+	tc->argc = rand() % 4;
+	for(size_t i = 0; i < tc->argc; i++) {
+		tc->argv[i] = random_imm(100);
+	}
+
+	/* initialise some locals like the compiler's pre-main code does */
+	if(rand() % 4 != 0) {
+		code[len++] = INSTR_PROLOG;
+		code[len++] = tc->argc + rand() % 8;
+		for(size_t i = 0; i < tc->argc; i++) {
+			code[len++] = INSTR_ARGLOAD;
+			code[len++] = i;
+		}
+	}
+
+	/*
+	 * Track the stack depth along the straight line code to avoid that
+	 * most programs just end with stack underflows.
+	 */
+	int depth = 0;
+
+	while(len < n) {
+		uint32_t op = random_opcode();
+		int pops = 0, pushes = 0;
+
+		if(aligned && op > INSTR_ARGLOAD) {
+			continue;
+		}
+
+		switch(op) {
+			case INSTR_PUSH:
+			case INSTR_LOAD:
+				pushes = 1;
+				break;
+			case INSTR_PRINT:
+			case INSTR_STORE:
+				pops = 1;
+				break;
+			case INSTR_ADD:
+			case INSTR_SUB:
+			case INSTR_MUL:
+			case INSTR_DIV:
+			case INSTR_MOD:
+				pops = 2;
+				pushes = 1;
+				break;
+			case INSTR_JEQ:
+			case INSTR_JNE:
+			case INSTR_JL:
+			case INSTR_JLE:
+			case INSTR_JG:
+			case INSTR_JGE:
+				pops = 2;
+				break;
+		}
+		if(depth < pops && rand() % 16 != 0) {
+			continue;
+		}
+		depth = (depth < pops) ? 0 : depth - pops + pushes;
+
+		starts[n_starts++] = len;
+		code[len++] = op;
+
+		uint32_t imm;
+		int is_target = 0, fits;
+		switch(op) {
+			case INSTR_PUSH:
+				imm = random_imm(20);
+				fits = (int32_t) imm >= -(1 << 23) && (int32_t) imm < (1 << 23);
+				break;
+			case INSTR_LOAD:
+			case INSTR_STORE:
+			case INSTR_PROLOG:
+			case INSTR_EPILOG:
+			case INSTR_ARGLOAD:
+				imm = random_imm(8);
+				fits = imm < (1 << 24);
+				break;
+			case INSTR_JMP:
+			case INSTR_JEQ:
+			case INSTR_JNE:
+			case INSTR_JL:
+			case INSTR_JLE:
+			case INSTR_JG:
+			case INSTR_JGE:
+			case INSTR_CALL:
+				is_target = 1;
+				imm = (rand() % 16 == 0) ? n + rand() % 16 : rand() % n;
+				fits = 1;
+				break;
+			default:
+				continue;
+		}
+
+		/* half of the immediates which fit go to the short form */
+		int short_form = fits && rand() % 2;
+		if(is_target) {
+			short_targets[n_targets] = short_form;
+			targets[n_targets++] = short_form ? len - 1 : len;
+		}
+		if(short_form) {
+			code[len - 1] = (imm << 8) | INSTR_SHORT | op;
+		} else {
+			code[len++] = imm;
+		}
+	}
+
+	if(aligned) {
+		for(size_t i = 0; i < n_targets; i++) {
+			uint32_t *word = &code[targets[i]];
+			if(short_targets[i]) {
+				*word = (starts[(*word >> 8) % n_starts] << 8) | (*word & 0xFF);
+			} else {
+				*word = starts[*word % n_starts];
+			}
+		}
+	}
+
+	/* finish at the end of the last line, and with one more full line */
+	while(len % 4 != 0) {
+		code[len++] = INSTR_FINISH;
+	}
+	for(int i = 0; i < 4; i++) {
+		code[len++] = INSTR_FINISH;
+	}
+
+	tc->code = code;
+	tc->code_len = len;
+
+	tc->config.stack_size = 1 + rand() % 6;
+	tc->config.call_size = 1 + rand() % 6;
+	tc->config.print_size = 1 + rand() % 16;
+	tc->config.max_steps = RANDOM_MAX_STEPS;
+
+	tc->ipc = (rand() % 8 == 0) ? DEFAULT_INSTR_PER_CYCLE : 1 + rand() % 40;
+}
+
+static int random_mode(unsigned int seed, size_t count) {
+	uint32_t code[MAX_RANDOM_LEN + 8];
+	size_t compared = 0, skipped = 0, failed = 0;
+	size_t errors[ERR_ARG_RANGE + 1] = {0};
+
+	srand(seed);
+
+	for(size_t i = 0; i < count; i++) {
+		struct test_case tc;
+		struct ref_result ref;
+
+		random_case(&tc, code);
+		int res = run_case(&tc, &ref);
+
+		if(res < 0) {
+			printf("case %zu (seed %u) differs:\n", i, seed);
+			dump_case(&tc);
+			failed++;
+		} else if(res > 0) {
+			skipped++;
+		} else {
+			compared++;
+			errors[ref.error_code]++;
+		}
+
+		ref_cleanup(&ref);
+	}
+
+	printf("%s (%s): %zu compared, %zu skipped, %zu failed\n",
+		bispe_user_encryption ? "encrypted" : "unencrypted", engine_name,
+		compared, skipped, failed);
+
+	if(verbose) {
+		for(size_t i = 0; i < ARRAY_SIZE(errors); i++) {
+			printf("  error code %zu: %zu\n", i, errors[i]);
+		}
+	}
+
+	return failed == 0 ? 0 : -1;
+}
+
+/***************************************************************************
+ *				COMPILED PROGRAMS
+ **************************************************************************/
+
+static uint32_t *read_code(const char *path, size_t *len) {
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL) {
+		fprintf(stderr, "error: could not open executable '%s'\n", path);
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	uint32_t *code = (size > 0 && size % 16 == 0) ? malloc(size) : NULL;
+	if(code == NULL || fread(code, 1, size, fp) != size) {
+		fprintf(stderr, "error: '%s' is no valid unencrypted executable\n", path);
+		free(code);
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+
+	*len = size / sizeof(uint32_t);
+	return code;
+}
+
+static int compiled_mode(struct test_case *tc, const char *path) {
+	static const uint64_t ipcs[] = { 1, 7, DEFAULT_INSTR_PER_CYCLE };
+	int failed = 0;
+
+	tc->code = read_code(path, &tc->code_len);
+	if(tc->code == NULL) {
+		return -1;
+	}
+
+	tc->config.print_size = 64;
+	tc->config.max_steps = COMPILED_MAX_STEPS;
+
+	for(size_t i = 0; i < ARRAY_SIZE(ipcs); i++) {
+		struct ref_result ref;
+
+		tc->ipc = ipcs[i];
+		int res = run_case(tc, &ref);
+
+		if(res != 0) {
+			printf("%s (ipc %lu): %s\n", path, (unsigned long) tc->ipc,
+				(res < 0) ? "differs" : "could not be compared");
+			failed = 1;
+		} else if(verbose) {
+			printf("%s (ipc %lu): equal, %zu instructions, error code %d\n",
+				path, (unsigned long) tc->ipc, ref.steps, ref.error_code);
+		}
+
+		ref_cleanup(&ref);
+	}
+
+	free(tc->code);
+	return failed ? -1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned int seed = 1;
+	size_t count = 1000;
+	int compiled = 0;
+	int features = bispe_check_features();
+
+	struct test_case tc = {
+		.config = {
+			.stack_size = DEFAULT_STACK_SIZE,
+			.call_size = DEFAULT_CALL_SIZE,
+		}
+	};
+
+	int opt;
+	while((opt = getopt_long(argc, argv, "+s:n:cv", cmd_options, NULL)) != -1) {
+		switch(opt) {
+			case 's':
+				seed = strtoul(optarg, NULL, 0);
+				break;
+			case 'n':
+				count = strtoul(optarg, NULL, 0);
+				break;
+			case 'c':
+				compiled = 1;
+				break;
+			case 'v':
+				verbose = 1;
+				break;
+			case 0x1:
+				tc.config.stack_size = strtoul(optarg, NULL, 0);
+				break;
+			case 0x2:
+				tc.config.call_size = strtoul(optarg, NULL, 0);
+				break;
+			case 0x3:
+				if(features > BISPE_FEATURES_VAES) {
+					features = BISPE_FEATURES_VAES;
+				}
+				break;
+			case 0x4:
+				if(features > BISPE_FEATURES_AVX) {
+					features = BISPE_FEATURES_AVX;
+				}
+				break;
+			case 0x5:
+				bispe_set_verification(0);
+				break;
+			default:
+				puts(usage);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	signal(SIGALRM, timeout_handler);
+
+	engine_name = bispe_select_engine(features);
+
+	if(bispe_user_encryption) {
+		bispe_user_set_password("bispe-differential");
+	}
+
+	int res;
+	if(compiled) {
+		if(optind >= argc) {
+			puts(usage);
+			exit(EXIT_FAILURE);
+		}
+
+		tc.argc = argc - optind - 1;
+		if(tc.argc > ARRAY_SIZE(tc.argv)) {
+			fprintf(stderr, "error: too many arguments\n");
+			exit(EXIT_FAILURE);
+		}
+		for(size_t i = 0; i < tc.argc; i++) {
+			tc.argv[i] = strtol(argv[optind + 1 + i], NULL, 0);
+		}
+
+		res = compiled_mode(&tc, argv[optind]);
+	} else {
+		res = random_mode(seed, count);
+	}
+
+	return (res == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
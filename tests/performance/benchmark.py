@@ -0,0 +1,445 @@
+#!/usr/bin/env python3
+#
+# benchmark.py
+#
+# Copyright (C) 2014-2016	Max Seitzer <maximilian.seitzer@fau.de>
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms and conditions of the GNU General Public License,
+# version 2, as published by the Free Software Foundation.
+#
+# This program is distributed in the hope it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+# more details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+# Place - Suite 330, Boston, MA 02111-1307 USA.
+#
+# Runs the benchmark programs of the interpreter and the baseline languages.
+# Every command runs pinned to one CPU, after discarding warm up runs.
+# Reported are median, 95th percentile and a distribution free 95% confidence
+# interval of the median, plus hardware counters if perf is available
+# (collected in separate runs, so that perf does not disturb the timings).
+#
+# usage:
+#   ./benchmark.py build
+#   ./benchmark.py run [options] [suite...]   (see ./benchmark.py run -h)
+#   ./benchmark.py compare <baseline.json> <current.json> [--threshold <pct>]
+import argparse, datetime, json, math, os, platform, shutil, subprocess
+import sys, tempfile, time
+
+root_dir = "../.."
+user_bispe = root_dir + "/backend/user/bispe_user"
+user_bispe_plain = root_dir + "/backend/user-plain/bispe_user"
+kernel_bispe = root_dir + "/bin/bispe"
+
+perf_events = ["cycles", "instructions", "branch-misses"]
+
+# program: (arguments, java class name)
+# the workloads without java class only have a C baseline
+programs = {
+	"fib" : (["35"], "Fib"),
+	"primes" : (["1000000"], "Primes"),
+	"pascal" : (["23"], "Pascal"),
+	"checksum" : (["500000"], None),
+	"modexp" : (["50000"], None),
+	"gcd" : (["1000"], None),
+	"omega" : (["150000"], None),
+	"treesum" : (["20"], None),
+	"calls" : (["500000"], None),
+}
+
+# variants every program is run in, ratios are given relative to "c"
+variants = ["bispe", "bispe-noenc", "c", "java", "python"]
+
+# the settings the historical results in result/ were measured with
+bispe_settings = ["--call-size=30", "--stack-size=30"]
+
+def bispe_command(engine, encrypted, program, args, ipc=2000):
+	settings = bispe_settings + ["--instr-per-cycle=%d" % ipc]
+	if engine == "kernel":
+		ext = ".scle" if encrypted else ".sclu"
+		return [kernel_bispe] + settings + ["scll/" + program + ext] + args
+
+	binary = user_bispe if encrypted else user_bispe_plain
+	return [binary, "-u"] + settings + ["scll/" + program + ".sclu"] + args
+
+def variant_command(variant, engine, program):
+	args, java_class = programs[program]
+	if variant == "bispe":
+		return bispe_command(engine, True, program, args)
+	elif variant == "bispe-noenc":
+		# the kernel module would have to be rebuilt with ENCRYPTION=0
+		if engine == "kernel":
+			return None
+		return bispe_command(engine, False, program, args)
+	elif variant == "c":
+		return ["c/" + program] + args
+	elif variant == "java":
+		if java_class is None:
+			return None
+		return ["java", "-cp", "java", java_class] + args
+	elif variant == "python":
+		if not os.path.exists("python/" + program + ".py"):
+			return None
+		return [sys.executable, "python/" + program + ".py"] + args
+
+def available(cmd):
+	binary = cmd[0]
+	if os.path.sep in binary:
+		return os.access(binary, os.X_OK)
+	return shutil.which(binary) is not None
+
+def suite_benchmarks(suite, engine, selected_variants):
+	""" returns list of (name, command) for a suite """
+	benchmarks = []
+	if suite in programs:
+		for variant in selected_variants:
+			cmd = variant_command(variant, engine, suite)
+			if cmd is not None:
+				benchmarks.append((suite + "/" + variant, cmd))
+	elif suite == "instr_per_cycle":
+		for ipc in [10, 15, 20, 25, 50, 75, 100, 250, 500, 750, 1000,
+					2500, 5000, 7500]:
+			cmd = bispe_command(engine, True, "fib", programs["fib"][0], ipc)
+			benchmarks.append(("instr_per_cycle/%d" % ipc, cmd))
+	else:
+		sys.exit("unknown suite '%s'" % suite)
+	return benchmarks
+
+###########################################################################
+#				STATISTICS
+###########################################################################
+
+def median(samples):
+	s = sorted(samples)
+	n = len(s)
+	return s[n // 2] if n % 2 == 1 else (s[n // 2 - 1] + s[n // 2]) / 2.0
+
+def percentile(samples, p):
+	""" nearest rank percentile """
+	s = sorted(samples)
+	rank = int(math.ceil(p / 100.0 * len(s)))
+	return s[max(rank, 1) - 1]
+
+def stdev(samples):
+	if len(samples) < 2:
+		return 0.0
+	mean = sum(samples) / len(samples)
+	return math.sqrt(sum((x - mean) ** 2 for x in samples) / (len(samples) - 1))
+
+def median_ci(samples, confidence=0.95):
+	"""
+	Distribution free confidence interval of the median from order
+	statistics: the number of samples below the median is binomially
+	distributed. Returns (low, high, exact), with min and max as
+	interval if there are too few samples for the requested confidence.
+	"""
+	s = sorted(samples)
+	n = len(s)
+	alpha = (1 - confidence) / 2
+
+	j, cdf = -1, 0.0
+	for i in range(n):
+		cdf += math.comb(n, i) / 2.0 ** n
+		if cdf > alpha:
+			break
+		j = i
+
+	if j < 0:
+		return (s[0], s[-1], False)
+	return (s[j], s[n - 1 - j], True)
+
+def summarize(samples):
+	low, high, exact = median_ci(samples)
+	return {
+		"n" : len(samples),
+		"median" : median(samples),
+		"p95" : percentile(samples, 95),
+		"mean" : sum(samples) / len(samples),
+		"stdev" : stdev(samples),
+		"min" : min(samples),
+		"max" : max(samples),
+		"ci95" : [low, high],
+		"ci95_exact" : exact,
+	}
+
+###########################################################################
+#				RUNNING
+###########################################################################
+
+def pin(cpu):
+	if cpu is None:
+		return None
+	return lambda: os.sched_setaffinity(0, {cpu})
+
+def run_timed(cmd, cpu):
+	start = time.perf_counter()
+	proc = subprocess.run(cmd, stdout=subprocess.DEVNULL,
+		stderr=subprocess.PIPE, preexec_fn=pin(cpu))
+	elapsed = time.perf_counter() - start
+
+	if proc.returncode != 0:
+		raise RuntimeError("'%s' failed: %s" % (" ".join(cmd),
+			proc.stderr.decode(errors="replace").strip()))
+	return elapsed
+
+def run_perf(cmd, cpu):
+	with tempfile.NamedTemporaryFile(mode="r", suffix=".perf") as out:
+		perf_cmd = ["perf", "stat", "-x,", "-e", ",".join(perf_events),
+			"-o", out.name, "--"] + cmd
+		run_timed(perf_cmd, cpu)
+
+		counters = {}
+		for line in out:
+			fields = line.strip().split(",")
+			if len(fields) < 3 or line.startswith("#"):
+				continue
+			for event in perf_events:
+				if fields[2].startswith(event):
+					try:
+						counters[event] = float(fields[0])
+					except ValueError:
+						counters[event] = None
+		return counters
+
+def run_benchmark(name, cmd, options):
+	for i in range(options.warmup):
+		run_timed(cmd, options.cpu)
+
+	samples = [run_timed(cmd, options.cpu) for i in range(options.runs)]
+	result = {"command" : cmd, "samples" : samples}
+	result.update(summarize(samples))
+
+	if options.perf_runs > 0:
+		runs = [run_perf(cmd, options.cpu) for i in range(options.perf_runs)]
+		counters = {}
+		for event in perf_events:
+			values = [r[event] for r in runs if r.get(event) is not None]
+			counters[event] = median(values) if values else None
+		result["counters"] = counters
+
+	return result
+
+def ratios(results):
+	""" overhead of every variant relative to c, and of encryption """
+	ratios = {}
+	for program in programs:
+		medians = {}
+		for variant in variants:
+			key = program + "/" + variant
+			if key in results:
+				medians[variant] = results[key]["median"]
+		if not medians:
+			continue
+
+		r = {}
+		if "c" in medians:
+			for variant, value in medians.items():
+				if variant != "c":
+					r[variant + "/c"] = value / medians["c"]
+		if "bispe" in medians and "bispe-noenc" in medians:
+			r["bispe/bispe-noenc"] = medians["bispe"] / medians["bispe-noenc"]
+		ratios[program] = r
+	return ratios
+
+def read_file(path):
+	try:
+		with open(path) as f:
+			return f.read()
+	except OSError:
+		return None
+
+def metadata(options):
+	cpu_model = None
+	cpuinfo = read_file("/proc/cpuinfo") or ""
+	for line in cpuinfo.splitlines():
+		if line.startswith("model name"):
+			cpu_model = line.split(":", 1)[1].strip()
+			break
+
+	try:
+		git = subprocess.run(["git", "rev-parse", "HEAD"], capture_output=True,
+			text=True).stdout.strip() or None
+	except OSError:
+		git = None
+
+	governor = None
+	if options.cpu is not None:
+		governor = read_file("/sys/devices/system/cpu/cpu%d/cpufreq/"
+			"scaling_governor" % options.cpu)
+
+	return {
+		"date" : datetime.datetime.now().isoformat(timespec="seconds"),
+		"host" : platform.node(),
+		"kernel" : platform.release(),
+		"cpu_model" : cpu_model,
+		"cpu" : options.cpu,
+		"governor" : governor.strip() if governor else None,
+		"git" : git,
+		"engine" : options.engine,
+		"runs" : options.runs,
+		"warmup" : options.warmup,
+		"perf_runs" : options.perf_runs,
+	}
+
+def fmt_time(t):
+	return "%.4f" % t
+
+def cmd_run(options):
+	if options.cpu is None:
+		options.cpu = max(os.sched_getaffinity(0))
+	if options.cpu < 0:
+		options.cpu = None
+
+	if options.perf_runs > 0 and shutil.which("perf") is None:
+		print("perf not found, no hardware counters are collected")
+		options.perf_runs = 0
+
+	selected = options.variants.split(",") if options.variants else variants
+	for variant in selected:
+		if variant not in variants:
+			sys.exit("unknown variant '%s'" % variant)
+
+	benchmarks = []
+	for suite in options.suites or list(programs):
+		benchmarks += suite_benchmarks(suite, options.engine, selected)
+
+	results = {}
+	print("%-26s %8s %8s %19s %7s" % ("benchmark", "median", "p95",
+		"95% ci", "stdev"))
+	for name, cmd in benchmarks:
+		if not available(cmd):
+			print("%-26s skipped, '%s' not built or not installed" %
+				(name, cmd[0]))
+			continue
+
+		try:
+			result = run_benchmark(name, cmd, options)
+		except RuntimeError as e:
+			print("%-26s failed: %s" % (name, e))
+			continue
+
+		results[name] = result
+		ci = "%s-%s%s" % (fmt_time(result["ci95"][0]),
+			fmt_time(result["ci95"][1]), "" if result["ci95_exact"] else "*")
+		line = "%-26s %8s %8s %19s %7s" % (name, fmt_time(result["median"]),
+			fmt_time(result["p95"]), ci, fmt_time(result["stdev"]))
+
+		counters = result.get("counters", {})
+		if counters.get("cycles") and counters.get("instructions"):
+			line += "  ipc %.2f" % (counters["instructions"] / counters["cycles"])
+		if counters.get("branch-misses") is not None:
+			line += "  br-miss %.3g" % counters["branch-misses"]
+		print(line)
+
+	output = {
+		"meta" : metadata(options),
+		"benchmarks" : results,
+		"ratios" : ratios(results),
+	}
+
+	for program, r in sorted(output["ratios"].items()):
+		if r:
+			print("%s: %s" % (program, ", ".join("%s %.2f" % (k, v)
+				for k, v in sorted(r.items()))))
+
+	if options.output:
+		with open(options.output, "w") as f:
+			json.dump(output, f, indent=1)
+		print("results written to " + options.output)
+
+###########################################################################
+#				COMPARISON
+###########################################################################
+
+def cmd_compare(options):
+	with open(options.baseline) as f:
+		baseline = json.load(f)["benchmarks"]
+	with open(options.current) as f:
+		current = json.load(f)["benchmarks"]
+
+	threshold = options.threshold / 100.0
+	regressions = 0
+
+	print("%-26s %8s %8s %8s" % ("benchmark", "before", "after", "change"))
+	for name in sorted(set(baseline) & set(current)):
+		old, new = baseline[name], current[name]
+		change = new["median"] / old["median"] - 1
+
+		# only significant if the confidence intervals do not overlap
+		verdict = ""
+		if change > threshold and new["ci95"][0] > old["ci95"][1]:
+			verdict = "REGRESSION"
+			regressions += 1
+		elif change < -threshold and new["ci95"][1] < old["ci95"][0]:
+			verdict = "improved"
+
+		print("%-26s %8s %8s %+7.1f%%  %s" % (name, fmt_time(old["median"]),
+			fmt_time(new["median"]), change * 100, verdict))
+
+	for name in sorted(set(baseline) ^ set(current)):
+		print("%-26s only in %s" % (name,
+			"baseline" if name in baseline else "current"))
+
+	if regressions > 0:
+		print("%d regression(s) over %.1f%%" % (regressions, options.threshold))
+		sys.exit(1)
+
+###########################################################################
+#				BUILDING
+###########################################################################
+
+def cmd_build(options):
+	commands = [
+		"make -C %s/compiler" % root_dir,
+		"make -C %s/backend user" % root_dir,
+		"make -C %s/backend user ENCRYPTION=0 USER_OUT=user-plain" % root_dir,
+		"./build.py",
+	]
+	for command in commands:
+		if os.system(command) != 0:
+			print("'%s' failed" % command)
+
+def main():
+	# all paths are relative to this directory
+	os.chdir(os.path.dirname(os.path.abspath(__file__)))
+
+	parser = argparse.ArgumentParser(description="bispe benchmark harness")
+	sub = parser.add_subparsers(dest="command", required=True)
+
+	build = sub.add_parser("build", help="build interpreter and programs")
+	build.set_defaults(func=cmd_build)
+
+	run = sub.add_parser("run", help="run benchmark suites")
+	run.add_argument("suites", nargs="*", help="suites to run: " +
+		", ".join(list(programs) + ["instr_per_cycle"]) + " (default: all programs)")
+	run.add_argument("-r", "--runs", type=int, default=10,
+		help="measured runs per benchmark (default: 10)")
+	run.add_argument("-w", "--warmup", type=int, default=2,
+		help="discarded warm up runs (default: 2)")
+	run.add_argument("-p", "--perf-runs", type=int, default=3,
+		help="runs under perf stat for counters, 0 to disable (default: 3)")
+	run.add_argument("-c", "--cpu", type=int, default=None,
+		help="cpu to pin to, -1 to disable (default: last available cpu)")
+	run.add_argument("-e", "--engine", choices=["user", "kernel"],
+		default="user", help="interpreter to run (default: user space build)")
+	run.add_argument("-v", "--variants", default=None,
+		help="comma separated variants (default: " + ",".join(variants) + ")")
+	run.add_argument("-o", "--output", default=None, help="json output file")
+	run.set_defaults(func=cmd_run)
+
+	compare = sub.add_parser("compare", help="compare two json results")
+	compare.add_argument("baseline")
+	compare.add_argument("current")
+	compare.add_argument("-t", "--threshold", type=float, default=3.0,
+		help="regression threshold in percent (default: 3)")
+	compare.set_defaults(func=cmd_compare)
+
+	options = parser.parse_args()
+	options.func(options)
+
+if __name__ == "__main__":
+	main()
@@ -1,36 +1,55 @@
-#!/usr/bin/env python
+#!/usr/bin/env python3
+#
+# build.py
+#
+# Builds the benchmark programs of all languages.
+# Bispe programs are compiled encrypted (.scle, needs the loaded kernel
+# module) and unencrypted (.sclu, for the user space build of the interpreter).
 import os, sys, shutil
 
+compiler = "../../../compiler/compiler"
+
 languages = {
-	"scll" : (".scll", ".scle"),
-	"java" : (".java", ".class"),
-	"c" : (".c", "")
+	"scll" : (".scll", [".scle", ".sclu"]),
+	"java" : (".java", [".class"]),
+	"c" : (".c", [""])
 }
 
 compiling = {
-	"scll" : "./compiler {}.scll", 
-	"java" : "javac {}.java",
-	"c" : "gcc -std=c99 -Werror -Wall -o {0} {0}.c",
+	"scll" : [compiler + " {0}.scll", compiler + " -u -o {0}.sclu {0}.scll"],
+	"java" : ["javac {}.java"],
+	"c" : ["gcc -std=c99 -Werror -Wall -o {0} {0}.c"],
 }
 
+# programs with a baseline in every language
 programs = ["fib", "primes", "pascal"]
 
+# workload corpus, only written in scll and C
+workloads = ["checksum", "modexp", "gcd", "omega", "treesum", "calls"]
+
+def programs_of(folder):
+	if folder in ["scll", "c"]:
+		return programs + workloads
+	return programs
+
 def make():
-	for folder, build in compiling.iteritems():
-		for program in programs:
+	for folder, builds in compiling.items():
+		for program in programs_of(folder):
 			if folder == "java":
 				program = program.title()
-			os.system("cd " + folder + " && " + build.format(program))
+			for build in builds:
+				os.system("cd " + folder + " && " + build.format(program))
 
 def clean():
-	for folder, ext in languages.iteritems():
-		for program in programs:
+	for folder, ext in languages.items():
+		for program in programs_of(folder):
 			if folder == "java":
 				program = program.title()
-			os.system("cd " + folder + " && rm -f " + program + ext[1])
+			for out_ext in ext[1]:
+				os.system("cd " + folder + " && rm -f " + program + out_ext)
 
 
 if len(sys.argv) == 2 and sys.argv[1] == "clean":
 	clean()
 else:
-	make()
\ No newline at end of file
+	make()
@@ -0,0 +1,48 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+static uint32_t level1(uint32_t x) {
+	return (x * 3) + 1;
+}
+
+static uint32_t level2(uint32_t x) {
+	return level1(x + 2) - x;
+}
+
+static uint32_t level3(uint32_t x) {
+	return level2(x * 5) + level1(x);
+}
+
+static uint32_t level4(uint32_t x) {
+	return level3(x - 7) + 11;
+}
+
+static uint32_t level5(uint32_t x) {
+	return level4(x + 13) * 3;
+}
+
+static uint32_t level6(uint32_t x) {
+	return level5(x) - level1(x * 17);
+}
+
+static uint32_t level7(uint32_t x) {
+	return level6(x + 19) + 23;
+}
+
+static uint32_t level8(uint32_t x) {
+	return level7(x * 29) % 65521;
+}
+
+int main(int argc, char const *argv[]) {
+	int i;
+	int n = atoi(argv[1]);
+	uint32_t acc = 0;
+
+	for(i = 0; i < n; i = i + 1) {
+		acc = acc + level8(i + acc);
+	}
+	printf("%d\n", (int32_t) acc);
+
+	return 0;
+}
@@ -0,0 +1,45 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+/* bispe arithmetic wraps around at 32 bit and divides unsigned */
+static uint32_t mix(uint32_t a, uint32_t b, uint32_t c, uint32_t d,
+		uint32_t e, uint32_t f, uint32_t g, uint32_t h) {
+	uint32_t t0 = (a * 31) + b;
+	uint32_t t1 = (b * 37) + c;
+	uint32_t t2 = (c * 41) + d;
+	uint32_t t3 = (d * 43) + e;
+	uint32_t t4 = (e * 47) + f;
+	uint32_t t5 = (f * 53) + g;
+	uint32_t t6 = (g * 59) + h;
+	uint32_t t7 = (h * 61) + a;
+	uint32_t u0 = (t0 + t4) - (t1 * 3);
+	uint32_t u1 = (t1 + t5) - (t2 * 5);
+	uint32_t u2 = (t2 + t6) - (t3 * 7);
+	uint32_t u3 = (t3 + t7) - (t0 * 11);
+	uint32_t v0 = (u0 * u1) + (u2 - u3);
+	uint32_t v1 = (u2 * u3) + (u0 - u1);
+	return (v0 * 65599) + (v1 + (t4 - t6));
+}
+
+int main(int argc, char const *argv[]) {
+	int i;
+	int n = atoi(argv[1]);
+	uint32_t s1 = 1;
+	uint32_t s2 = 0;
+	uint32_t x = 12345;
+	uint32_t h = 0;
+
+	for(i = 0; i < n; i = i + 1) {
+		x = (x * 1103515245) + 12345;
+		s1 = (s1 + (x % 251)) % 65521;
+		s2 = (s2 + s1) % 65521;
+		h = mix(h, x, s1, s2, i, h + x, x - s1, s2 * 7);
+	}
+	printf("%d\n", (int32_t) s1);
+	printf("%d\n", (int32_t) s2);
+	printf("%d\n", (int32_t) ((s2 * 65536) + s1));
+	printf("%d\n", (int32_t) h);
+
+	return 0;
+}
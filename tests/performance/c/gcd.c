@@ -0,0 +1,35 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+	if(b == 0) {
+		return a;
+	}
+	return gcd(b, a % b);
+}
+
+int main(int argc, char const *argv[]) {
+	int a, b;
+	int n = atoi(argv[1]);
+	uint32_t coprime = 0;
+	uint32_t gcd_sum = 0;
+	uint32_t lcm_sum = 0;
+	uint32_t g;
+
+	for(a = 1; a <= n; a = a + 1) {
+		for(b = 1; b <= a; b = b + 1) {
+			g = gcd(a, b);
+			if(g == 1) {
+				coprime = coprime + 1;
+			}
+			gcd_sum = gcd_sum + g;
+			lcm_sum = lcm_sum + ((a / g) * b);
+		}
+	}
+	printf("%d\n", (int32_t) coprime);
+	printf("%d\n", (int32_t) gcd_sum);
+	printf("%d\n", (int32_t) lcm_sum);
+
+	return 0;
+}
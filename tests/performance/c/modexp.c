@@ -0,0 +1,54 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+static uint32_t mulmod(uint32_t a, uint32_t b, uint32_t m) {
+	return (a * b) % m;
+}
+
+static uint32_t square(uint32_t a, uint32_t m) {
+	return mulmod(a, a, m);
+}
+
+static uint32_t is_odd(uint32_t e) {
+	return e % 2;
+}
+
+static uint32_t modexp(uint32_t b, uint32_t e, uint32_t m) {
+	uint32_t r = 1;
+	uint32_t base = b % m;
+	uint32_t exp = e;
+
+	while(exp > 0) {
+		if(is_odd(exp) == 1) {
+			r = mulmod(r, base, m);
+		}
+		base = square(base, m);
+		exp = exp / 2;
+	}
+	return r;
+}
+
+static uint32_t fermat_witness(uint32_t a, uint32_t m) {
+	if(modexp(a, m - 1, m) == 1) {
+		return 0;
+	}
+	return 1;
+}
+
+int main(int argc, char const *argv[]) {
+	int i;
+	int n = atoi(argv[1]);
+	uint32_t m = 46337;
+	uint32_t sum = 0;
+	uint32_t witnesses = 0;
+
+	for(i = 1; i <= n; i = i + 1) {
+		sum = sum + modexp(i, 65537, m);
+		witnesses = witnesses + fermat_witness((i % (m - 2)) + 2, 46339);
+	}
+	printf("%d\n", (int32_t) sum);
+	printf("%d\n", (int32_t) witnesses);
+
+	return 0;
+}
@@ -0,0 +1,46 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+static int smallest_factor(int k) {
+	int d;
+
+	if(k % 2 == 0) {
+		return 2;
+	}
+	for(d = 3; d * d <= k; d = d + 2) {
+		if(k % d == 0) {
+			return d;
+		}
+	}
+	return k;
+}
+
+static int omega(int k) {
+	int count = 0;
+	int rest = k;
+
+	while(rest > 1) {
+		rest = rest / smallest_factor(rest);
+		count = count + 1;
+	}
+	return count;
+}
+
+int main(int argc, char const *argv[]) {
+	int k, c;
+	int n = atoi(argv[1]);
+	int primes = 0;
+	int total = 0;
+
+	for(k = 2; k <= n; k = k + 1) {
+		c = omega(k);
+		if(c == 1) {
+			primes = primes + 1;
+		}
+		total = total + c;
+	}
+	printf("%d\n", primes);
+	printf("%d\n", total);
+
+	return 0;
+}
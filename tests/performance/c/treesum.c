@@ -0,0 +1,20 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+static uint32_t value(uint32_t id) {
+	return (id * 40503) % 1000;
+}
+
+static uint32_t tree_sum(uint32_t id, int depth) {
+	if(depth == 0) {
+		return value(id);
+	}
+	return value(id) + (tree_sum(id * 2, depth - 1) + tree_sum((id * 2) + 1, depth - 1));
+}
+
+int main(int argc, char const *argv[]) {
+	int depth = atoi(argv[1]);
+	printf("%d\n", (int32_t) tree_sum(1, depth));
+	return 0;
+}
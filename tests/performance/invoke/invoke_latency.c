@@ -0,0 +1,363 @@
+/***************************************************************************
+ * invoke_latency.c
+ * Latency of single interpreter invokes of tiny programs
+ *
+ * Copyright (C) 2014-2016	Max Seitzer <maximilian.seitzer@fau.de>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place - Suite 330, Boston, MA 02111-1307 USA.
+ *
+ ***************************************************************************/
+
+/*
+ * For programs which execute only a few instructions, the fixed cost of an
+ * invoke dominates. Every program given is invoked many times, reported are
+ * p50 and p99 of the end-to-end latency and of every invoke phase
+ * (see enum invoke_event in bispe_comm.h).
+ *
+ * Built against the user space library (invoke-user-*), the phases are taken
+ * from the library directly. There is no kernel thread in user space, so
+ * thread start is only the setup in start_interpreter, and wakeup and thread
+ * stop are zero.
+ * Built for the kernel module (invoke-kernel), every invoke is done like in
+ * the frontend, and the phases are read from /sys/kernel/bispe/stats, which
+ * is only present if the module was built with STATS=1. The sysfs phase is
+ * the end-to-end latency minus the time spent in the store handler.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef BISPE_USER
+#include "bispe_user.h"
+#include "bispe_comm.h"
+#include "bispe_interpreter.h"
+
+#ifndef STATS
+#error "invoke_latency needs a library built with STATS=1"
+#endif
+#else
+#include "bispe_comm.h"
+
+static const char *backend_invoke = "/sys/kernel/bispe/invoke";
+static const char *backend_stats = "/sys/kernel/bispe/stats";
+#endif
+
+#define MAX_ARGS 8
+#define PRINT_SIZE 16
+
+static const char usage[] =
+	"usage: ./invoke-<variant> [-n <invokes>] [-w <warm up invokes>] "
+	"program[:arg:arg...]...";
+
+/* phase i lasts from event i to event i+1, the sysfs phase comes first */
+#define PHASES INVOKE_EVENTS
+
+static const char *phase_names[PHASES] = {
+	"sysfs write",
+	"copy in",
+	"allocation",
+	"thread start",
+	"execution",
+	"wakeup",
+	"thread stop",
+	"copy out",
+	"cleanup",
+};
+
+struct program {
+	const char *path;
+	char *file_buf;
+	size_t code_size;
+	uint32_t argv[MAX_ARGS];
+	size_t argc;
+};
+
+struct sample {
+	uint64_t total;
+	uint64_t phase[PHASES];
+};
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static char *read_file(const char *path, size_t *size) {
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL) {
+		fprintf(stderr, "error: could not open executable '%s'\n", path);
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	long len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	/* leave space in front for the init vector of unencrypted code */
+	char *buf = malloc(len + 16);
+	if(buf == NULL || fread(buf + 16, 1, len, fp) != len) {
+		fprintf(stderr, "error: failed reading from '%s'\n", path);
+		free(buf);
+		buf = NULL;
+	}
+	fclose(fp);
+
+	*size = len;
+	return buf;
+}
+
+/* parses "path:arg:arg..." */
+static int parse_program(char *spec, struct program *prog) {
+	prog->path = strtok(spec, ":");
+	prog->argc = 0;
+	prog->file_buf = NULL;
+
+	char *arg;
+	while((arg = strtok(NULL, ":")) != NULL) {
+		if(prog->argc == MAX_ARGS) {
+			fprintf(stderr, "error: too many arguments for '%s'\n", prog->path);
+			return -1;
+		}
+		prog->argv[prog->argc++] = (uint32_t) strtol(arg, NULL, 0);
+	}
+
+	prog->file_buf = read_file(prog->path, &prog->code_size);
+	if(prog->file_buf == NULL) {
+		return -1;
+	}
+	if(prog->code_size == 0 || prog->code_size % 16 != 0) {
+		fprintf(stderr, "error: code must be multiple of 128 bit\n");
+		return -1;
+	}
+
+#ifdef BISPE_USER
+	/* executables are unencrypted (compiled with -u), see bispe_user_main.c */
+	if(bispe_user_encryption) {
+		get_random_bytes(prog->file_buf, 16);
+		if(bispe_user_encrypt_code((u8 *) prog->file_buf, prog->code_size + 16) != 0) {
+			return -1;
+		}
+		prog->code_size += 16;
+		return 0;
+	}
+#endif
+	/* executable is used as it is, without the space in front */
+	memmove(prog->file_buf, prog->file_buf + 16, prog->code_size);
+	return 0;
+}
+
+#ifdef BISPE_USER
+
+/* runs the steps of the store handler of the kernel module in place */
+static int invoke(struct invoke_ctx *invoke_ctx, struct sample *s) {
+	uint64_t start = now_ns();
+	bispe_invoke_stamps[INVOKE_ENTER] = start;
+
+	struct runtime_ctx *runtime_ctx = init_interpreter_intern(invoke_ctx);
+	if(runtime_ctx == NULL) {
+		return -1;
+	}
+
+	*invoke_ctx->result = start_interpreter(runtime_ctx, 0);
+	bispe_invoke_stamps[INVOKE_WOKEN] = bispe_invoke_stamps[INVOKE_EXEC_END];
+	bispe_invoke_stamps[INVOKE_STOPPED] = bispe_invoke_stamps[INVOKE_EXEC_END];
+
+	memcpy(invoke_ctx->out_buf.ptr, bispe_get_print_seg_bp(),
+		4 * bispe_get_print_count());
+	bispe_stamp(INVOKE_COPIED_OUT);
+
+	cleanup_runtime_ctx(runtime_ctx);
+	bispe_stamp(INVOKE_DONE);
+
+	s->total = now_ns() - start;
+	s->phase[0] = 0;
+	for(int i = 1; i < PHASES; i++) {
+		s->phase[i] = bispe_invoke_stamps[i] - bispe_invoke_stamps[i-1];
+	}
+	return 0;
+}
+
+#else
+
+/* reads the phases of the last invoke, returns -1 if not available */
+static int read_stats(struct sample *s) {
+	char buf[256];
+	int fd = open(backend_stats, O_RDONLY);
+	if(fd == -1) {
+		return -1;
+	}
+	ssize_t len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if(len <= 0) {
+		return -1;
+	}
+	buf[len] = '\0';
+
+	char *pos = buf;
+	uint64_t handler = 0;
+	for(int i = 1; i < PHASES; i++) {
+		s->phase[i] = strtoull(pos, &pos, 10);
+		handler += s->phase[i];
+	}
+	s->phase[0] = (s->total > handler) ? s->total - handler : 0;
+	return 0;
+}
+
+/* invokes like the frontend does, see write_sys in bispe.c */
+static int invoke(struct invoke_ctx *invoke_ctx, struct sample *s) {
+	uint64_t start = now_ns();
+
+	int fd = open(backend_invoke, O_WRONLY);
+	if(fd == -1) {
+		fprintf(stderr, "error: could not open %s\n", backend_invoke);
+		return -1;
+	}
+	ssize_t res = write(fd, invoke_ctx, sizeof(*invoke_ctx));
+	close(fd);
+
+	s->total = now_ns() - start;
+	if(res == -1) {
+		return -1;
+	}
+
+	if(read_stats(s) != 0) {
+		memset(s->phase, 0, sizeof(s->phase));
+	}
+	return 0;
+}
+
+#endif
+
+static int cmp_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return (x > y) - (x < y);
+}
+
+/* sorts the values, returns p50 and p99 */
+static void percentiles(uint64_t *values, size_t n, double *p50, double *p99) {
+	qsort(values, n, sizeof(values[0]), cmp_u64);
+	*p50 = values[n / 2] / 1000.0;
+	*p99 = values[(n * 99) / 100] / 1000.0;
+}
+
+static int run_program(struct program *prog, size_t invokes, size_t warmup) {
+	uint32_t print_buf[PRINT_SIZE];
+	int result = -1;
+
+	struct invoke_ctx invoke_ctx = {
+		.code_buf = { (void *) prog->file_buf, prog->code_size },
+		.arg_buf = { (void *) prog->argv, prog->argc * sizeof(uint32_t) },
+		.result = &result,
+		.out_buf = { (void *) print_buf, sizeof(print_buf) }
+	};
+
+	struct sample *samples = malloc(invokes * sizeof(*samples));
+	uint64_t *values = malloc(invokes * sizeof(*values));
+	if(samples == NULL || values == NULL) {
+		fprintf(stderr, "error: could not allocate samples\n");
+		free(samples);
+		return -1;
+	}
+
+	for(size_t i = 0; i < warmup + invokes; i++) {
+		struct sample s;
+		result = -1;
+		if(invoke(&invoke_ctx, &s) != 0 || result != 0) {
+			fprintf(stderr, "error: invoking '%s' failed (result %d)\n",
+				prog->path, result);
+			free(samples);
+			free(values);
+			return -1;
+		}
+		if(i >= warmup) {
+			samples[i - warmup] = s;
+		}
+	}
+
+	double p50, p99;
+	for(size_t i = 0; i < invokes; i++) {
+		values[i] = samples[i].total;
+	}
+	percentiles(values, invokes, &p50, &p99);
+
+	printf("%s (%zu invokes)\n", prog->path, invokes);
+	printf("  %-16s %10.2f %10.2f\n", "end-to-end", p50, p99);
+
+	for(int p = 0; p < PHASES; p++) {
+		for(size_t i = 0; i < invokes; i++) {
+			values[i] = samples[i].phase[p];
+		}
+		percentiles(values, invokes, &p50, &p99);
+		printf("  %-16s %10.2f %10.2f\n", phase_names[p], p50, p99);
+	}
+
+	free(samples);
+	free(values);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	size_t invokes = 5000;
+	size_t warmup = 100;
+
+	int opt;
+	while((opt = getopt(argc, argv, "n:w:")) != -1) {
+		switch(opt) {
+			case 'n':
+				invokes = strtoul(optarg, NULL, 0);
+				break;
+			case 'w':
+				warmup = strtoul(optarg, NULL, 0);
+				break;
+			default:
+				puts(usage);
+				exit(EXIT_FAILURE);
+		}
+	}
+	if(invokes == 0 || optind >= argc) {
+		puts(usage);
+		exit(EXIT_FAILURE);
+	}
+
+#ifdef BISPE_USER
+	if(bispe_user_encryption) {
+		bispe_user_set_password("bispe-invoke");
+	}
+	printf("user space library, %s\n",
+		bispe_user_encryption ? "encrypted" : "unencrypted");
+#else
+	printf("kernel module%s\n", (access(backend_stats, R_OK) == 0)
+		? "" : " (built without STATS, phases not available)");
+#endif
+	printf("  %-16s %10s %10s\n", "[us]", "p50", "p99");
+
+	int failed = 0;
+	for(int i = optind; i < argc; i++) {
+		struct program prog;
+		if(parse_program(argv[i], &prog) != 0 ||
+				run_program(&prog, invokes, warmup) != 0) {
+			failed = 1;
+		}
+		free(prog.file_buf);
+	}
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,456 @@
+/***************************************************************************
+ * microbench.c
+ * Micro benchmarks of single instruction cycle operations
+ *
+ * Copyright (C) 2014-2016	Max Seitzer <maximilian.seitzer@fau.de>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place - Suite 330, Boston, MA 02111-1307 USA.
+ *
+ ***************************************************************************/
+
+/*
+ * Every benchmark is a bytecode program generated here, which executes an
+ * unrolled body in a counted loop. The programs are run on the user space
+ * build of the interpreter with STATS enabled, so that besides the time per
+ * instruction, the block en-/decryptions per instruction can be reported.
+ * The counter loop (7 instructions) is included in all numbers.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bispe_user.h"
+#include "bispe_comm.h"
+#include "bispe_crypto.h"
+#include "bispe_defines.h"
+#include "bispe_interpreter.h"
+#include "bispe_state.h"
+
+#ifndef STATS
+#error "microbench needs a library built with STATS=1"
+#endif
+
+#define MAX_CODE_LEN 8192
+#define UNROLL 32
+
+/* call stack displacement of the loop counter */
+#define COUNTER 0
+
+static const char usage[] =
+	"usage: ./microbench [-r <runs>] [-n <instructions per run>] "
+	"[-i <instr per cycle>] [-a] [-v] [benchmark...]";
+
+struct program {
+	uint32_t code[MAX_CODE_LEN];
+	size_t len;
+	unsigned int stack_size;
+	unsigned int call_size;
+	/* position of the call immediate in the call benchmark */
+	size_t call_site;
+	/* frame size of the functions in the call benchmark */
+	unsigned int call_frame;
+};
+
+struct benchmark {
+	const char *name;
+	const char *desc;
+	/* emits setup and the body which is executed per loop iteration */
+	void (*setup)(struct program *prog, int arg);
+	void (*body)(struct program *prog, int arg);
+	int arg;
+};
+
+/***************************************************************************
+ *				CODE GENERATION
+ **************************************************************************/
+
+static void emit(struct program *prog, uint32_t opcode) {
+	if(prog->len >= MAX_CODE_LEN) {
+		fprintf(stderr, "error: benchmark program too large\n");
+		exit(EXIT_FAILURE);
+	}
+	prog->code[prog->len++] = opcode;
+}
+
+static void emit_imm(struct program *prog, uint32_t opcode, uint32_t imm) {
+	emit(prog, opcode);
+	emit(prog, imm);
+}
+
+/* emits the short form, with the immediate in the opcode word */
+static void emit_short(struct program *prog, uint32_t opcode, uint32_t imm) {
+	emit(prog, (imm << 8) | INSTR_SHORT | opcode);
+}
+
+/*
+ * Generates: setup, counter = iterations; do { body } while(--counter > 0);
+ * The setup has to reserve the counter on the call stack.
+ */
+static void generate(struct program *prog, const struct benchmark *bench,
+					 uint32_t iterations) {
+	prog->len = 0;
+	prog->stack_size = 4;
+	prog->call_size = 4;
+	prog->call_frame = 1;
+
+	bench->setup(prog, bench->arg);
+	emit_imm(prog, INSTR_PUSH, iterations);
+	emit_imm(prog, INSTR_STORE, COUNTER);
+
+	size_t head = prog->len;
+	bench->body(prog, bench->arg);
+
+	emit_imm(prog, INSTR_LOAD, COUNTER);
+	emit_imm(prog, INSTR_PUSH, 1);
+	emit(prog, INSTR_SUB);
+	emit_imm(prog, INSTR_STORE, COUNTER);
+	emit_imm(prog, INSTR_LOAD, COUNTER);
+	emit_imm(prog, INSTR_PUSH, 0);
+	emit_imm(prog, INSTR_JG, head);
+	emit(prog, INSTR_FINISH);
+
+	/* functions of the call benchmark are placed behind the main loop */
+	while(prog->len % 4 != 0) {
+		emit(prog, INSTR_FINISH);
+	}
+}
+
+/* default setup: a frame for the counter and a few locals */
+static void setup_frame(struct program *prog, int arg) {
+	emit_imm(prog, INSTR_PROLOG, 4);
+}
+
+/* pushes arg elements, so that push/pop work at the given stack offset */
+static void setup_stack(struct program *prog, int arg) {
+	setup_frame(prog, arg);
+	for(int i = 0; i < arg; i++) {
+		emit_imm(prog, INSTR_PUSH, i);
+	}
+}
+
+static void body_push_pop(struct program *prog, int arg) {
+	for(int i = 0; i < UNROLL; i++) {
+		emit_imm(prog, INSTR_PUSH, i);
+		emit_imm(prog, INSTR_STORE, 1);
+	}
+}
+
+static void body_push_pop_short(struct program *prog, int arg) {
+	for(int i = 0; i < UNROLL; i++) {
+		emit_short(prog, INSTR_PUSH, i);
+		emit_short(prog, INSTR_STORE, 1);
+	}
+}
+
+static void body_nop(struct program *prog, int arg) {
+	for(int i = 0; i < 4 * UNROLL; i++) {
+		emit(prog, INSTR_NOP);
+	}
+}
+
+static void body_arith(struct program *prog, int arg) {
+	for(int i = 0; i < UNROLL; i++) {
+		emit_imm(prog, INSTR_PUSH, 3);
+		emit(prog, (i % 2 == 0) ? INSTR_ADD : INSTR_MUL);
+	}
+}
+
+static void body_arith_short(struct program *prog, int arg) {
+	for(int i = 0; i < UNROLL; i++) {
+		emit_short(prog, INSTR_PUSH, 3);
+		emit(prog, (i % 2 == 0) ? INSTR_ADD : INSTR_MUL);
+	}
+}
+
+static void body_empty(struct program *prog, int arg) {
+}
+
+/* frame of arg+1 elements, the counter is at the top */
+static void setup_deep_frame(struct program *prog, int arg) {
+	emit_imm(prog, INSTR_PROLOG, arg + 1);
+	prog->call_size = (arg + 1) / 4 + 2;
+}
+
+static void body_load_store(struct program *prog, int arg) {
+	for(int i = 0; i < UNROLL; i++) {
+		emit_imm(prog, INSTR_LOAD, arg);
+		emit_imm(prog, INSTR_STORE, 1);
+	}
+}
+
+/*
+ * Chain of arg functions, each one calling the next one with a frame
+ * of one element. The functions are placed behind the loop by
+ * patching the call target after generation.
+ */
+static void setup_calls(struct program *prog, int arg) {
+	setup_frame(prog, arg);
+	prog->call_size = (2 * arg + 4) / 4 + 2;
+}
+
+/*
+ * Like setup_calls, but with frames of three elements, so that every
+ * return address starts a new call line (compiler option -l)
+ */
+static void setup_line_calls(struct program *prog, int arg) {
+	emit_imm(prog, INSTR_PROLOG, 3);
+	prog->call_frame = 3;
+	prog->call_size = arg + 3;
+}
+
+static void body_calls(struct program *prog, int arg) {
+	emit_imm(prog, INSTR_CALL, 0);
+	prog->call_site = prog->len - 1;
+}
+
+static void emit_call_chain(struct program *prog, int depth) {
+	prog->code[prog->call_site] = prog->len;
+
+	for(int i = 0; i < depth - 1; i++) {
+		/* prolog, call, epilog and ret take 7 words */
+		size_t next = prog->len + 7;
+
+		emit_imm(prog, INSTR_PROLOG, prog->call_frame);
+		emit_imm(prog, INSTR_CALL, next);
+		emit_imm(prog, INSTR_EPILOG, prog->call_frame);
+		emit(prog, INSTR_RET);
+	}
+	emit(prog, INSTR_RET);
+
+	while(prog->len % 4 != 0) {
+		emit(prog, INSTR_FINISH);
+	}
+}
+
+static const struct benchmark benchmarks[] = {
+	{ "push_pop", "push/pop within a stack line",
+		setup_stack, body_push_pop, 1 },
+	{ "push_pop_short", "push/pop within a stack line, short forms",
+		setup_stack, body_push_pop_short, 1 },
+	{ "push_pop_boundary", "push/pop across a stack line boundary",
+		setup_stack, body_push_pop, 3 },
+	{ "nop_lines", "straight line nops over many code lines",
+		setup_frame, body_nop, 0 },
+	{ "arith_lines", "straight line push/add/mul over many code lines",
+		setup_stack, body_arith, 1 },
+	{ "arith_lines_short", "straight line push/add/mul, short forms",
+		setup_stack, body_arith_short, 1 },
+	{ "backward_jump", "tight loop, one backward jump per 7 instructions",
+		setup_frame, body_empty, 0 },
+	{ "call_ret_4", "call/return chains of depth 4",
+		setup_calls, body_calls, 4 },
+	{ "call_ret_32", "call/return chains of depth 32",
+		setup_calls, body_calls, 32 },
+	{ "call_ret_32_lines", "call/return chains of depth 32, line frames",
+		setup_line_calls, body_calls, 32 },
+	{ "load_store_0", "load/store in the top call line",
+		setup_deep_frame, body_load_store, 0 },
+	{ "load_store_4", "load/store one call line apart",
+		setup_deep_frame, body_load_store, 4 },
+	{ "load_store_16", "load/store four call lines apart",
+		setup_deep_frame, body_load_store, 16 },
+	{ "load_store_60", "load/store fifteen call lines apart",
+		setup_deep_frame, body_load_store, 60 },
+};
+
+/***************************************************************************
+ *				EXECUTION
+ **************************************************************************/
+
+struct measurement {
+	uint64_t instr;
+	uint64_t enc;
+	uint64_t dec;
+	uint64_t ns;
+};
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int run_program(const struct program *prog, uint64_t ipc,
+					   struct measurement *m) {
+	size_t code_bytes = prog->len * sizeof(uint32_t);
+	uint8_t *buf = malloc(code_bytes + 16);
+	int ret = -1;
+
+	if(buf == NULL) {
+		return -1;
+	}
+	memcpy(buf + 16, prog->code, code_bytes);
+
+	struct invoke_ctx invoke_ctx = {
+		.stack_size = prog->stack_size,
+		.call_size = prog->call_size,
+		.ipc = ipc,
+		.code_buf = { buf + 16, code_bytes },
+		.out_buf = { NULL, 16 }
+	};
+
+	if(bispe_user_encryption) {
+		get_random_bytes(buf, 16);
+		if(bispe_user_encrypt_code(buf, code_bytes + 16) != 0) {
+			goto out;
+		}
+		invoke_ctx.code_buf.ptr = buf;
+		invoke_ctx.code_buf.size += 16;
+	}
+
+	struct runtime_ctx *runtime_ctx = init_interpreter_intern(&invoke_ctx);
+	if(runtime_ctx == NULL) {
+		goto out;
+	}
+
+	bispe_stat_instr = 0;
+	bispe_stat_enc = 0;
+	bispe_stat_dec = 0;
+
+	uint64_t start = now_ns();
+	int res = start_interpreter(runtime_ctx, 0);
+	m->ns = now_ns() - start;
+
+	m->instr = bispe_stat_instr;
+	m->enc = bispe_stat_enc;
+	m->dec = bispe_stat_dec;
+
+	cleanup_runtime_ctx(runtime_ctx);
+
+	if(res != 0) {
+		fprintf(stderr, "error: benchmark stopped with error %d\n", res);
+		goto out;
+	}
+	ret = 0;
+
+out:
+	free(buf);
+	return ret;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return (x > y) - (x < y);
+}
+
+static int run_benchmark(const struct benchmark *bench, size_t runs,
+						 uint64_t instr_per_run, uint64_t ipc) {
+	static struct program prog;
+	struct measurement m;
+	uint64_t times[runs];
+
+	/* calibrate iterations with a single iteration */
+	generate(&prog, bench, 1);
+	if(bench->body == body_calls) {
+		emit_call_chain(&prog, bench->arg);
+	}
+	if(run_program(&prog, ipc, &m) != 0) {
+		return -1;
+	}
+
+	uint64_t iterations = instr_per_run / (m.instr > 0 ? m.instr : 1) + 1;
+	generate(&prog, bench, iterations);
+	if(bench->body == body_calls) {
+		emit_call_chain(&prog, bench->arg);
+	}
+
+	/* one warm up run, which also provides the counts */
+	if(run_program(&prog, ipc, &m) != 0) {
+		return -1;
+	}
+
+	for(size_t i = 0; i < runs; i++) {
+		struct measurement cur;
+		if(run_program(&prog, ipc, &cur) != 0) {
+			return -1;
+		}
+		times[i] = cur.ns;
+	}
+	qsort(times, runs, sizeof(times[0]), cmp_u64);
+
+	double instr = (double) m.instr;
+	printf("%-20s %10lu %9.2f %8.3f %8.3f %8.3f   %s\n", bench->name,
+		(unsigned long) m.instr, times[runs / 2] / instr,
+		m.enc / instr, m.dec / instr, (m.enc + m.dec) / instr, bench->desc);
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	size_t runs = 11;
+	uint64_t instr_per_run = 2000000;
+	uint64_t ipc = DEFAULT_INSTR_PER_CYCLE;
+	int features = bispe_check_features();
+
+	int opt;
+	while((opt = getopt(argc, argv, "r:n:i:av")) != -1) {
+		switch(opt) {
+			case 'r':
+				runs = strtoul(optarg, NULL, 0);
+				break;
+			case 'n':
+				instr_per_run = strtoull(optarg, NULL, 0);
+				break;
+			case 'i':
+				ipc = strtoull(optarg, NULL, 0);
+				break;
+			case 'a':
+				/* AVX engine even if VAES or AVX-512 is available */
+				features = BISPE_FEATURES_AVX;
+				break;
+			case 'v':
+				/* AVX engine with VAES even if AVX-512 is available */
+				if(features > BISPE_FEATURES_VAES) {
+					features = BISPE_FEATURES_VAES;
+				}
+				break;
+			default:
+				puts(usage);
+				exit(EXIT_FAILURE);
+		}
+	}
+	if(runs == 0 || ipc == 0) {
+		puts(usage);
+		exit(EXIT_FAILURE);
+	}
+
+	if(bispe_user_encryption) {
+		bispe_user_set_password("bispe-microbench");
+	}
+
+	printf("%s, %s engine, %lu instructions per cycle, median of %zu runs\n",
+		bispe_user_encryption ? "encrypted" : "unencrypted",
+		bispe_select_engine(features), (unsigned long) ipc, runs);
+	printf("%-20s %10s %9s %8s %8s %8s\n", "benchmark", "instr",
+		"ns/instr", "enc/ins", "dec/ins", "aes/ins");
+
+	int failed = 0;
+	for(size_t i = 0; i < ARRAY_SIZE(benchmarks); i++) {
+		/* run selected benchmarks only, if any given */
+		int selected = (optind >= argc);
+		for(int j = optind; j < argc; j++) {
+			selected |= (strcmp(argv[j], benchmarks[i].name) == 0);
+		}
+
+		if(selected && run_benchmark(&benchmarks[i], runs, instr_per_run, ipc) != 0) {
+			failed = 1;
+		}
+	}
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,4 +1,4 @@
-#!/usr/bin/env python
+#!/usr/bin/env python3
 import sys
 
 def fib(i):
@@ -12,7 +12,7 @@ def fib(i):
 
 def main():
 	n = int(sys.argv[1])
-	print fib(n)
+	print(fib(n))
 
 if __name__ == "__main__":
 	main()
\ No newline at end of file
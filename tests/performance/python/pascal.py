@@ -1,4 +1,4 @@
-#!/usr/bin/env python
+#!/usr/bin/env python3
 import sys
 
 def binom(n, k):
@@ -13,10 +13,10 @@ def binom(n, k):
 def main():
 	maxn = int(sys.argv[1])
 
-	for n in xrange(0, maxn):
-		for k in xrange(0, n+1):
-			print binom(n, k), 
-		print ""
+	for n in range(0, maxn):
+		for k in range(0, n+1):
+			print(binom(n, k), end=" ")
+		print("")
 
 if __name__ == "__main__":
 	main()
\ No newline at end of file
@@ -1,4 +1,4 @@
-#!/usr/bin/env python
+#!/usr/bin/env python3
 import sys
 
 def print_prime(p):
@@ -6,16 +6,16 @@ def print_prime(p):
 		return
 
 	i = 3
-	while i*i < p:
+	while i*i <= p:
 		if p % i == 0:
 			return
 		i += 2
 		
-	print p
+	print(p)
 
 def main():
 	max_prime = int(sys.argv[1])
-	for i in xrange(2, max_prime):
+	for i in range(2, max_prime + 1):
 		print_prime(i)
 
 if __name__ == "__main__":